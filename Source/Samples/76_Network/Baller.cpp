@@ -21,12 +21,14 @@
 //
 #include <Urho3D/Core/Context.h>
 #include <Urho3D/Scene/Scene.h>
+#include <Urho3D/Graphics/Graphics.h>
 #include <Urho3D/Graphics/Light.h>
 #include <Urho3D/Graphics/Material.h>
 #include <Urho3D/Graphics/Model.h>
 #include <Urho3D/Graphics/StaticModel.h>
 #include <Urho3D/Physics/RigidBody.h>
 #include <Urho3D/Physics/CollisionShape.h>
+#include <Urho3D/Physics/PhysicsEvents.h>
 #include <Urho3D/Resource/ResourceCache.h>
 #include <Urho3D/Input/Input.h>
 #include <Urho3D/UI/Text3D.h>
@@ -34,19 +36,32 @@
 #include <Urho3D/IO/Log.h>
 
 #include "Baller.h"
+#include "BallerSystem.h"
+#include "MaterialPalette.h"
+
+#include <Bullet/BulletDynamics/Dynamics/btRigidBody.h>
 
 #include <Urho3D/DebugNew.h>
 //=============================================================================
 //=============================================================================
 Baller::Baller(Context* context)
     : ClientObj(context)
+    , appliedColorIdx_(-1)
+    , system_(NULL)
+    , systemIndex_(0)
+    , culled_(false)
+    , simulationOnly_(false)
     , mass_(1.0f)
 {
     SetUpdateEventMask(0);
+
+    palette_ = GetSubsystem<MaterialPalette>();
 }
 
 Baller::~Baller()
 {
+    DetachMovement();
+
     if (nodeInfo_)
     {
         nodeInfo_->Remove();
@@ -62,6 +77,17 @@ void Baller::RegisterObject(Context* context)
 
 void Baller::ApplyAttributes()
 {
+    // clients: show replicated gear changes
+    ApplyColor();
+}
+
+void Baller::ApplyColor()
+{
+    if (!ballModel_ || !palette_ || colorIdx_ == appliedColorIdx_)
+        return;
+
+    ballModel_->SetMaterial(palette_->GetMaterial(colorIdx_));
+    appliedColorIdx_ = colorIdx_;
 }
 
 void Baller::DelayedStart()
@@ -73,12 +99,15 @@ void Baller::Create()
 {
     ResourceCache* cache = GetSubsystem<ResourceCache>();
 
-    // model
-    StaticModel* ballModel = node_->GetOrCreateComponent<StaticModel>();
-    ballModel->SetModel(cache->GetResource<Model>("Models/Sphere.mdl"));
-    String matName = ToString("NetDemo/ballmat%i.xml", colorIdx_);
-    ballModel->SetMaterial(cache->GetResource<Material>(matName));
-    ballModel->SetCastShadows(true);
+    // model. A simulation twin is ticked on another thread, where shared materials must not be touched
+    if (!simulationOnly_)
+    {
+        ballModel_ = node_->GetOrCreateComponent<StaticModel>();
+        ballModel_->SetModel(cache->GetResource<Model>("Models/Sphere.mdl"));
+        ballModel_->SetCastShadows(true);
+        appliedColorIdx_ = -1;
+        ApplyColor();
+    }
 
     // physics components
     hullBody_ = node_->GetOrCreateComponent<RigidBody>();
@@ -90,40 +119,154 @@ void Baller::Create()
     CollisionShape* shape = node_->GetOrCreateComponent<CollisionShape>();
     shape->SetSphere(1.0f);
 
-    // create text3d client info node LOCALLY
-    nodeInfo_ = GetScene()->CreateChild("light", LOCAL);
-    nodeInfo_->SetPosition(node_->GetPosition() + Vector3(0.0f, 1.1f, 0.0f));
-    Text3D *text3D = nodeInfo_->CreateComponent<Text3D>();
-    text3D->SetColor(Color::GREEN);
-    text3D->SetFont(cache->GetResource<Font>("Fonts/Anonymous Pro.ttf"), 12);
-    text3D->SetText(userName_);
-    text3D->SetFaceCameraMode(FC_ROTATE_XYZ);
+    // create text3d client info node LOCALLY, a headless server has nothing to display it on. A pooled baller
+    // already has one
+    if (!simulationOnly_ && GetSubsystem<Graphics>())
+    {
+        if (!nodeInfo_)
+        {
+            nodeInfo_ = GetScene()->CreateChild("light", LOCAL);
+            Text3D *text3D = nodeInfo_->CreateComponent<Text3D>();
+            text3D->SetColor(Color::GREEN);
+            text3D->SetFont(cache->GetResource<Font>("Fonts/Anonymous Pro.ttf"), 12);
+            text3D->SetFaceCameraMode(FC_ROTATE_XYZ);
+        }
+
+        nodeInfo_->SetPosition(node_->GetPosition() + Vector3(0.0f, 1.1f, 0.0f));
+        nodeInfo_->SetEnabled(true);
+        nodeInfo_->GetComponent<Text3D>()->SetText(userName_);
+    }
 
-    // register
-    SetUpdateEventMask(USE_FIXEDUPDATE);
+    if (!dormant_)
+    {
+        AttachMovement();
+    }
 }
 
-void Baller::SwapMat()
+void Baller::AttachMovement()
 {
-    ResourceCache* cache = GetSubsystem<ResourceCache>();
+    // out of the scene, Create attaches it again
+    if (!GetScene())
+        return;
+
+    // register with the scene's batched movement system if there is one, else move in our own FixedUpdate
+    BallerSystem* system = GetScene()->GetComponent<BallerSystem>();
+
+    if (system && !system_)
+    {
+        system_ = system;
+        systemIndex_ = system_->AddBaller(this, hullBody_);
+        system_->SetControls(systemIndex_, controls_.buttons_, controls_.yaw_);
+    }
+    else if (!system)
+    {
+        SetUpdateEventMask(USE_FIXEDUPDATE);
+    }
+}
+
+void Baller::DetachMovement()
+{
+    if (system_)
+    {
+        if (dormant_)
+            system_->RemoveDormant(systemIndex_);
+        else
+            system_->RemoveBaller(systemIndex_);
 
-    int idx = Random(MAX_MAT_COUNT);
+        system_ = NULL;
+    }
+}
+
+void Baller::ResetState()
+{
+    // awake and back in the movement system before the base clears the dormancy state
+    SetDormant(false);
+    ClientObj::ResetState();
+
+    prevControls_ = Controls();
+    SetCulled(false);
+
+    if (hullBody_)
+    {
+        hullBody_->SetLinearVelocity(Vector3::ZERO);
+        hullBody_->SetAngularVelocity(Vector3::ZERO);
+    }
+
+    // the name tag is a scene node of its own, it stays behind while the baller is pooled
+    if (nodeInfo_)
+    {
+        nodeInfo_->SetEnabled(false);
+    }
+}
+
+void Baller::OnSceneSet(Scene* scene)
+{
+    ClientObj::OnSceneSet(scene);
+
+    // leaving the scene, e.g. returned to the pool, Create registers again
+    if (!scene)
+    {
+        DetachMovement();
+    }
+}
+
+void Baller::SetControls(const Controls &controls)
+{
+    ClientObj::SetControls(controls);
+
+    if (dormant_)
+    {
+        if (!controls.buttons_)
+            return;
+
+        // any button wakes it, AttachMovement passes the controls on to the system
+        SetDormant(false);
+        return;
+    }
+
+    if (system_)
+    {
+        system_->SetControls(systemIndex_, controls.buttons_, controls.yaw_);
+    }
+}
+
+void Baller::ClearControls()
+{
+    ClientObj::ClearControls();
+
+    if (system_ && !dormant_)
+    {
+        system_->ClearButtons(systemIndex_);
+    }
+}
+
+void Baller::SwapMat()
+{
+    // the system's generator belongs to its scene, a room simulation thread can't share the global one
+    int idx = system_ ? system_->Random(MAX_MAT_COUNT) : Random(MAX_MAT_COUNT);
     while (idx == colorIdx_)
     {
-        idx = Random(MAX_MAT_COUNT);
+        idx = system_ ? system_->Random(MAX_MAT_COUNT) : Random(MAX_MAT_COUNT);
     }
 
+    SetColorIdx(idx);
+}
+
+void Baller::SetColorIdx(int colorIdx)
+{
+    if (colorIdx == colorIdx_)
+        return;
+
     // update serializable of the change
-    SetAttribute("Color Index", Variant(idx));
+    colorIdx_ = colorIdx;
+    MarkNetworkUpdate();
 
-    String matName = ToString("NetDemo/ballmat%i.xml", colorIdx_);
-    StaticModel* ballModel = node_->GetComponent<StaticModel>();
-    ballModel->SetMaterial(cache->GetResource<Material>(matName));
+    ApplyColor();
 }
 
 void Baller::FixedUpdate(float timeStep)
 {
-    if (!hullBody_ || !nodeInfo_)
+    if (!hullBody_)
     {
         return;
     }
@@ -157,7 +300,126 @@ void Baller::FixedUpdate(float timeStep)
     prevControls_ = controls_;
 
     // update text pos
-    nodeInfo_->SetPosition(node_->GetPosition() + Vector3(0.0f, 0.7f, 0.0f));
+    UpdateNodeInfo();
+
+    const float REST_SPEED = 0.1f;
+    bool idle = !controls_.buttons_ && hullBody_->GetLinearVelocity().LengthSquared() < REST_SPEED * REST_SPEED &&
+        hullBody_->GetAngularVelocity().LengthSquared() < REST_SPEED * REST_SPEED;
+
+    if (UpdateIdle(timeStep, idle))
+    {
+        SetDormant(true);
+    }
+}
+
+void Baller::SetDormant(bool dormant)
+{
+    if (dormant == dormant_)
+        return;
+
+    // the movement lists differ, leave with the current state and come back with the new one
+    BallerSystem* system = system_;
+    DetachMovement();
+    ClientObj::SetDormant(dormant);
+
+    if (dormant)
+    {
+        SetUpdateEventMask(0);
+
+        if (hullBody_)
+        {
+            // the zero velocities are what clients get last, then Bullet stops integrating the body and wakes it
+            // itself when an active body touches it
+            hullBody_->SetLinearVelocity(Vector3::ZERO);
+            hullBody_->SetAngularVelocity(Vector3::ZERO);
+            if (hullBody_->GetBody())
+                hullBody_->GetBody()->setActivationState(ISLAND_SLEEPING);
+        }
+
+        // in a system the dormant list is checked for woken bodies each step, without one the collision event tells
+        if (system)
+        {
+            system_ = system;
+            systemIndex_ = system_->AddDormant(this, hullBody_);
+        }
+        else if (node_)
+        {
+            SubscribeToEvent(node_, E_NODECOLLISIONSTART, URHO3D_HANDLER(Baller, HandleNodeCollisionStart));
+        }
+    }
+    else
+    {
+        if (node_)
+        {
+            UnsubscribeFromEvent(node_, E_NODECOLLISIONSTART);
+        }
+
+        if (hullBody_)
+        {
+            hullBody_->Activate();
+        }
+
+        AttachMovement();
+    }
+}
+
+void Baller::HandleNodeCollisionStart(StringHash eventType, VariantMap& eventData)
+{
+    SetDormant(false);
+}
+
+void Baller::GetTransformState(TransformState& state) const
+{
+    ClientObj::GetTransformState(state);
+
+    if (hullBody_)
+    {
+        state.linearVelocity_ = hullBody_->GetLinearVelocity();
+        state.angularVelocity_ = hullBody_->GetAngularVelocity();
+    }
+}
+
+void Baller::ApplyTransformState(const TransformState& state)
+{
+    ClientObj::ApplyTransformState(state);
+
+    // keep the local body moving between updates
+    if (hullBody_)
+    {
+        hullBody_->SetLinearVelocity(state.linearVelocity_);
+        hullBody_->SetAngularVelocity(state.angularVelocity_);
+    }
+
+    UpdateNodeInfo();
+}
+
+void Baller::SetCulled(bool culled)
+{
+    if (culled == culled_)
+        return;
+
+    culled_ = culled;
+
+    if (ballModel_)
+    {
+        ballModel_->SetEnabled(!culled);
+    }
+    if (hullBody_)
+    {
+        hullBody_->SetEnabled(!culled);
+    }
+    if (nodeInfo_)
+    {
+        nodeInfo_->SetEnabled(!culled);
+    }
+}
+
+void Baller::UpdateNodeInfo()
+{
+    if (nodeInfo_)
+    {
+        nodeInfo_->SetPosition(node_->GetPosition() + Vector3(0.0f, 0.7f, 0.0f));
+    }
 }
 
 
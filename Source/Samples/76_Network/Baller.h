@@ -28,9 +28,15 @@ namespace Urho3D
 class Controls;
 class Node;
 class RigidBody;
+class StaticModel;
 }
 
 using namespace Urho3D;
+//=============================================================================
+//=============================================================================
+class BallerSystem;
+class MaterialPalette;
+
 //=============================================================================
 //=============================================================================
 static const unsigned CTRL_FORWARD = (1<<0);
@@ -57,16 +63,53 @@ public:
     virtual void ApplyAttributes();
     virtual void DelayedStart();
     virtual void Create();
+    virtual void SetControls(const Controls &controls);
+    virtual void ClearControls();
+    virtual void ResetState();
+    /// Server: a dormant baller leaves the movement system (or stops its FixedUpdate) and its body is put to sleep in
+    /// Bullet. Buttons held or a collision wake it.
+    virtual void SetDormant(bool dormant);
 
-protected:
+    /// Server: pick a new material at random, from the BallerSystem's generator when there is one.
     void SwapMat();
+    /// Server: change the material, replicated to clients.
+    void SetColorIdx(int colorIdx);
+    void UpdateNodeInfo();
+    /// Client: hide a remote baller that is outside the interest radius.
+    void SetCulled(bool culled);
+    /// Server: a room simulation's twin is physics only, it gets no model, material or name tag. Set before Create.
+    void SetSimulationOnly(bool simulationOnly) { simulationOnly_ = simulationOnly; }
+    virtual void ApplyTransformState(const TransformState& state);
+    virtual void GetTransformState(TransformState& state) const;
+
+    /// Called by the BallerSystem when it moves or drops this baller.
+    void SetSystemIndex(unsigned index) { systemIndex_ = index; }
+    void DetachSystem() { system_ = NULL; }
+
+protected:
+    virtual void OnSceneSet(Scene* scene);
     virtual void FixedUpdate(float timeStep);
+    void ApplyColor();
+    /// Move with the scene's BallerSystem if there is one, else in our own FixedUpdate.
+    void AttachMovement();
+    /// Leave the BallerSystem's active or dormant list.
+    void DetachMovement();
+
+    void HandleNodeCollisionStart(StringHash eventType, VariantMap& eventData);
    
 protected:
     WeakPtr<RigidBody> hullBody_;
+    WeakPtr<StaticModel> ballModel_;
+    WeakPtr<MaterialPalette> palette_;
+    int appliedColorIdx_;
     WeakPtr<Node> nodeInfo_;
     Controls prevControls_;
 
+    BallerSystem* system_;
+    unsigned systemIndex_;
+    bool culled_;
+    bool simulationOnly_;
+
     float mass_;
 };
 
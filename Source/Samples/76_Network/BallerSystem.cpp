@@ -0,0 +1,224 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Scene/Scene.h>
+#include <Urho3D/Physics/PhysicsEvents.h>
+#include <Urho3D/Physics/PhysicsWorld.h>
+#include <Urho3D/Physics/RigidBody.h>
+#include <Urho3D/IO/Log.h>
+
+#include "BallerSystem.h"
+#include "Baller.h"
+#include "TickProfiler.h"
+
+#include <Urho3D/DebugNew.h>
+//=============================================================================
+//=============================================================================
+BallerSystem::BallerSystem(Context* context)
+    : Component(context)
+    , randomSeed_(Rand())
+{
+}
+
+BallerSystem::~BallerSystem()
+{
+    // ballers may outlive the system during scene teardown
+    for (unsigned i = 0; i < ballers_.Size(); ++i)
+    {
+        ballers_[i]->DetachSystem();
+    }
+    for (unsigned i = 0; i < dormantBallers_.Size(); ++i)
+    {
+        dormantBallers_[i]->DetachSystem();
+    }
+}
+
+void BallerSystem::RegisterObject(Context* context)
+{
+    context->RegisterFactory<BallerSystem>();
+}
+
+int BallerSystem::Random(int range)
+{
+    // same generator as Urho3D's Rand()
+    randomSeed_ = randomSeed_ * 214013 + 2531011;
+    return (int)((((randomSeed_ >> 16) & 32767) * (unsigned)range) >> 15);
+}
+
+unsigned BallerSystem::AddBaller(Baller* baller, RigidBody* body)
+{
+    unsigned index = ballers_.Size();
+
+    ballers_.Push(baller);
+    bodies_.Push(body);
+    yaw_.Push(0.0f);
+    buttons_.Push(0);
+    prevButtons_.Push(0);
+    torques_.Push(Vector3::ZERO);
+
+    return index;
+}
+
+void BallerSystem::RemoveBaller(unsigned index)
+{
+    // swap-remove, the last baller takes over the freed index
+    unsigned last = ballers_.Size() - 1;
+    if (index != last)
+    {
+        ballers_[index] = ballers_[last];
+        bodies_[index] = bodies_[last];
+        yaw_[index] = yaw_[last];
+        buttons_[index] = buttons_[last];
+        prevButtons_[index] = prevButtons_[last];
+        ballers_[index]->SetSystemIndex(index);
+    }
+
+    ballers_.Pop();
+    bodies_.Pop();
+    yaw_.Pop();
+    buttons_.Pop();
+    prevButtons_.Pop();
+    torques_.Pop();
+}
+
+unsigned BallerSystem::AddDormant(Baller* baller, RigidBody* body)
+{
+    dormantBallers_.Push(baller);
+    dormantBodies_.Push(body);
+
+    return dormantBallers_.Size() - 1;
+}
+
+void BallerSystem::RemoveDormant(unsigned index)
+{
+    unsigned last = dormantBallers_.Size() - 1;
+    if (index != last)
+    {
+        dormantBallers_[index] = dormantBallers_[last];
+        dormantBodies_[index] = dormantBodies_[last];
+        dormantBallers_[index]->SetSystemIndex(index);
+    }
+
+    dormantBallers_.Pop();
+    dormantBodies_.Pop();
+}
+
+void BallerSystem::Update(float timeStep)
+{
+    // A body hit by an active one is woken by Bullet. Waking swap-removes from the dormant list, walk it backwards so
+    // the baller moved into the freed index has already been checked
+    for (unsigned i = dormantBodies_.Size(); i-- > 0;)
+    {
+        if (dormantBodies_[i]->IsActive())
+        {
+            dormantBallers_[i]->SetDormant(false);
+        }
+    }
+
+    const float MOVE_TORQUE = 3.0f;
+    const unsigned count = ballers_.Size();
+
+    const float* yaw = yaw_.Buffer();
+    const unsigned* buttons = buttons_.Buffer();
+    Vector3* torques = torques_.Buffer();
+
+    // Torque in the baller's yaw frame is (forward - back) about the right axis plus (left - right) about the forward
+    // axis. Rotated about Y this reduces to a few multiply-adds per baller with no branches
+    for (unsigned i = 0; i < count; ++i)
+    {
+        float fwd = (float)((buttons[i] & CTRL_FORWARD) != 0) - (float)((buttons[i] & CTRL_BACK) != 0);
+        float side = (float)((buttons[i] & CTRL_LEFT) != 0) - (float)((buttons[i] & CTRL_RIGHT) != 0);
+        float s = Sin(yaw[i]);
+        float c = Cos(yaw[i]);
+
+        torques[i].x_ = (fwd * c + side * s) * MOVE_TORQUE;
+        torques[i].y_ = 0.0f;
+        torques[i].z_ = (side * c - fwd * s) * MOVE_TORQUE;
+    }
+
+    // apply batch
+    for (unsigned i = 0; i < count; ++i)
+    {
+        if (torques[i] != Vector3::ZERO)
+        {
+            bodies_[i]->ApplyTorque(torques[i]);
+        }
+    }
+
+    // rare per-baller work: material swap on press, and name tag follow
+    for (unsigned i = 0; i < count; ++i)
+    {
+        if ((buttons_[i] & SWAP_MAT) && !(prevButtons_[i] & SWAP_MAT))
+        {
+            ballers_[i]->SwapMat();
+        }
+
+        ballers_[i]->UpdateNodeInfo();
+    }
+
+    // update prev
+    prevButtons_ = buttons_;
+
+    // no buttons held and a body at rest for the baller's dormancy time puts it to sleep, backwards for the same
+    // reason as above
+    const float REST_SPEED = 0.1f;
+    for (unsigned i = count; i-- > 0;)
+    {
+        bool idle = !buttons_[i] && bodies_[i]->GetLinearVelocity().LengthSquared() < REST_SPEED * REST_SPEED &&
+            bodies_[i]->GetAngularVelocity().LengthSquared() < REST_SPEED * REST_SPEED;
+
+        if (ballers_[i]->UpdateIdle(timeStep, idle))
+        {
+            ballers_[i]->SetDormant(true);
+        }
+    }
+}
+
+void BallerSystem::OnSceneSet(Scene* scene)
+{
+    if (scene)
+    {
+        PhysicsWorld* physicsWorld = scene->GetComponent<PhysicsWorld>();
+
+        if (physicsWorld)
+        {
+            SubscribeToEvent(physicsWorld, E_PHYSICSPRESTEP, URHO3D_HANDLER(BallerSystem, HandlePhysicsPreStep));
+        }
+        else
+        {
+            URHO3D_LOGERROR("BallerSystem requires a PhysicsWorld created before it");
+        }
+    }
+    else
+    {
+        UnsubscribeFromEvent(E_PHYSICSPRESTEP);
+    }
+}
+
+void BallerSystem::HandlePhysicsPreStep(StringHash eventType, VariantMap& eventData)
+{
+    using namespace PhysicsPreStep;
+
+    TickProfileScope scope(GetSubsystem<TickProfiler>(), TICKSTAGE_BALLERS);
+    Update(eventData[P_TIMESTEP].GetFloat());
+}
@@ -0,0 +1,97 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include <Urho3D/Scene/Component.h>
+
+namespace Urho3D
+{
+class RigidBody;
+}
+
+using namespace Urho3D;
+//=============================================================================
+//=============================================================================
+class Baller;
+
+//=============================================================================
+//=============================================================================
+/// Scene-level movement system for all Ballers. Controls and rigid bodies are kept in structure-of-arrays form, torques
+/// are computed in one pass and applied in one batch per physics step, instead of a FixedUpdate per component.
+/// Create it as a LOCAL component on the scene before any Baller is created; without it Ballers use their own FixedUpdate.
+class BallerSystem : public Component
+{
+    URHO3D_OBJECT(BallerSystem, Component);
+
+public:
+    BallerSystem(Context* context);
+    virtual ~BallerSystem();
+
+    static void RegisterObject(Context* context);
+
+    /// Add a baller, returns its index in the system.
+    unsigned AddBaller(Baller* baller, RigidBody* body);
+    /// Remove a baller by index, the last baller is moved into its place.
+    void RemoveBaller(unsigned index);
+    /// Set controls of a baller by index.
+    void SetControls(unsigned index, unsigned buttons, float yaw)
+    {
+        buttons_[index] = buttons;
+        yaw_[index] = yaw;
+    }
+    /// Clear buttons of a baller by index.
+    void ClearButtons(unsigned index) { buttons_[index] = 0; }
+
+    /// Add a dormant baller, returns its index among the dormant ones. They get no movement, only a check each step
+    /// whether Bullet has woken their body.
+    unsigned AddDormant(Baller* baller, RigidBody* body);
+    /// Remove a dormant baller by index, the last dormant baller is moved into its place.
+    void RemoveDormant(unsigned index);
+
+    /// Return a random integer in [0, range) from the system's own generator, for use from the thread ticking the scene.
+    /// It is seeded from the global generator when the system is created on the main thread.
+    int Random(int range);
+
+    unsigned GetNumBallers() const { return ballers_.Size(); }
+    unsigned GetNumDormant() const { return dormantBallers_.Size(); }
+
+    /// Compute and apply torques for all ballers, wake dormant ballers a collision has touched and put idle ones to
+    /// sleep.
+    void Update(float timeStep);
+
+protected:
+    virtual void OnSceneSet(Scene* scene);
+
+    void HandlePhysicsPreStep(StringHash eventType, VariantMap& eventData);
+
+protected:
+    PODVector<Baller*> ballers_;
+    PODVector<RigidBody*> bodies_;
+    PODVector<float> yaw_;
+    PODVector<unsigned> buttons_;
+    PODVector<unsigned> prevButtons_;
+    PODVector<Vector3> torques_;
+    PODVector<Baller*> dormantBallers_;
+    PODVector<RigidBody*> dormantBodies_;
+    unsigned randomSeed_;
+};
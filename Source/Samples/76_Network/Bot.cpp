@@ -0,0 +1,200 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Graphics/Graphics.h>
+#include <Urho3D/IO/FileSystem.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/Network/Connection.h>
+#include <Urho3D/Network/Network.h>
+#include <Urho3D/Network/NetworkEvents.h>
+#include <Urho3D/Physics/PhysicsWorld.h>
+#include <Urho3D/Resource/ResourceCache.h>
+#include <Urho3D/Scene/Scene.h>
+
+#include "Bot.h"
+#include "Server.h"
+#include "ClientObj.h"
+#include "Baller.h"
+
+#include <Urho3D/DebugNew.h>
+//=============================================================================
+//=============================================================================
+Bot::Bot(Context* context, unsigned index)
+    : Object(context)
+    , network_(GetSubsystem<Network>())
+    , server_(GetSubsystem<Server>())
+    , index_(index)
+    , scriptTime_(0.0f)
+    , swapTime_(0.0f)
+    , connectTime_(-1.0f)
+    , clientObjectTime_(-1.0f)
+    , clientObjectID_(0)
+    , connected_(false)
+    , idle_(false)
+{
+    // replicated content lands in this scene, it is never updated or rendered
+    scene_ = new Scene(context_);
+    server_->RegisterClientHashAndScene(Baller::GetTypeStatic(), scene_);
+
+    SubscribeToEvent(E_SERVERSTATUS, URHO3D_HANDLER(Bot, HandleServerStatus));
+    SubscribeToEvent(E_CLIENTOBJECTID, URHO3D_HANDLER(Bot, HandleClientObjectID));
+}
+
+Bot::~Bot()
+{
+}
+
+void Bot::Connect(const String &address, unsigned short port)
+{
+    // random identity, same shape as the sample's connect button
+    VariantMap identity;
+    identity["UserName"] = ToString("bot%u", index_);
+    identity["ColorIdx"] = Random(MAX_MAT_COUNT);
+
+    connectTimer_.Reset();
+    server_->Connect(address, port, identity);
+}
+
+void Bot::Disconnect()
+{
+    server_->Disconnect();
+    connected_ = false;
+}
+
+void Bot::Update(float timeStep)
+{
+    network_->Update(timeStep);
+
+    if (connected_)
+    {
+        if (!idle_)
+        {
+            UpdateScript(timeStep);
+        }
+        server_->UpdatePhysicsPreStep(controls_);
+    }
+
+    network_->PostUpdate(timeStep);
+}
+
+float Bot::GetBytesInPerSec() const
+{
+    Connection* serverConnection = network_->GetServerConnection();
+    return serverConnection ? serverConnection->GetBytesInPerSec() : 0.0f;
+}
+
+float Bot::GetBytesOutPerSec() const
+{
+    Connection* serverConnection = network_->GetServerConnection();
+    return serverConnection ? serverConnection->GetBytesOutPerSec() : 0.0f;
+}
+
+void Bot::UpdateScript(float timeStep)
+{
+    const float PHASE_TIME = 1.5f;
+    const float SWAP_INTERVAL = 5.0f;
+    const float SWAP_HOLD = 0.2f;
+    static const unsigned phaseButtons[] = { CTRL_FORWARD, CTRL_FORWARD | CTRL_LEFT, CTRL_BACK, CTRL_RIGHT };
+
+    scriptTime_ += timeStep;
+    swapTime_ += timeStep;
+
+    // walk a square-ish path, offset per bot so they don't move in lockstep
+    unsigned phase = ((unsigned)(scriptTime_ / PHASE_TIME) + index_) % 4;
+    controls_.buttons_ = phaseButtons[phase];
+    controls_.yaw_ += 30.0f * timeStep;
+
+    // periodic gear swap, held briefly like a key press
+    if (swapTime_ >= SWAP_INTERVAL)
+    {
+        controls_.buttons_ |= SWAP_MAT;
+
+        if (swapTime_ >= SWAP_INTERVAL + SWAP_HOLD)
+        {
+            swapTime_ = 0.0f;
+        }
+    }
+}
+
+void Bot::HandleServerStatus(StringHash eventType, VariantMap& eventData)
+{
+    using namespace ServerStatus;
+    StringHash msg = eventData[P_STATUS].GetStringHash();
+
+    if (msg == E_SERVERCONNECTED)
+    {
+        connected_ = true;
+        connectTime_ = connectTimer_.GetUSec(false) / 1000.0f;
+    }
+    else
+    {
+        if (msg == E_CONNECTFAILED)
+        {
+            URHO3D_LOGWARNINGF("bot%u connect failed", index_);
+        }
+
+        connected_ = false;
+    }
+}
+
+void Bot::HandleClientObjectID(StringHash eventType, VariantMap& eventData)
+{
+    clientObjectID_ = eventData[ClientObjectID::P_ID].GetUInt();
+    clientObjectTime_ = connectTimer_.GetUSec(false) / 1000.0f;
+}
+
+SharedPtr<Context> Bot::CreateContext(Context* parent, bool compactTransforms)
+{
+    SharedPtr<Context> context(new Context());
+
+    context->RegisterSubsystem(new Time(context));
+    context->RegisterSubsystem(new FileSystem(context));
+
+    // replicated components reference models and materials, resolve them from the same resource dirs
+    ResourceCache* cache = new ResourceCache(context);
+    context->RegisterSubsystem(cache);
+    const StringVector& resourceDirs = parent->GetSubsystem<ResourceCache>()->GetResourceDirs();
+    for (unsigned i = 0; i < resourceDirs.Size(); ++i)
+    {
+        cache->AddResourceDir(resourceDirs[i]);
+    }
+
+    // every replicated component type must be known or the scene update can't be parsed
+    RegisterResourceLibrary(context);
+    RegisterSceneLibrary(context);
+    RegisterGraphicsLibrary(context);
+    RegisterPhysicsLibrary(context);
+
+    context->RegisterSubsystem(new Network(context));
+
+    Server* server = new Server(context);
+    context->RegisterSubsystem(server);
+    server->SetCompactTransforms(compactTransforms);
+
+    ClientObj::RegisterObject(context);
+    Baller::RegisterObject(context);
+
+    return context;
+}
@@ -0,0 +1,96 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Input/Controls.h>
+
+namespace Urho3D
+{
+class Scene;
+class Network;
+}
+
+using namespace Urho3D;
+//=============================================================================
+//=============================================================================
+class Server;
+
+//=============================================================================
+//=============================================================================
+/// One simulated client. Each bot lives in its own Context with its own Network and Server subsystems, since the
+/// engine allows one server connection per Network instance. Its network is pumped manually by its owner.
+class Bot : public Object
+{
+    URHO3D_OBJECT(Bot, Object);
+
+public:
+    Bot(Context* context, unsigned index);
+    virtual ~Bot();
+
+    void Connect(const String &address, unsigned short port);
+    void Disconnect();
+    void Update(float timeStep);
+    /// An idle bot stays connected and sends input, but never presses anything, like an AFK player.
+    void SetIdle(bool idle) { idle_ = idle; }
+    bool IsIdle() const { return idle_; }
+
+    /// Create a context for a bot, with the subsystems and object factories a replicating client needs. Resources
+    /// resolve from the parent context's resource dirs.
+    static SharedPtr<Context> CreateContext(Context* parent, bool compactTransforms);
+
+    bool IsConnected() const { return connected_; }
+    bool HasClientObject() const { return clientObjectTime_ >= 0.0f; }
+    float GetConnectTime() const { return connectTime_; }
+    float GetClientObjectTime() const { return clientObjectTime_; }
+    float GetBytesInPerSec() const;
+    float GetBytesOutPerSec() const;
+    /// Scene the server replicates into, and the ID of the bot's own ball in it, 0 until spawned.
+    Scene* GetScene() const { return scene_; }
+    unsigned GetClientObjectID() const { return clientObjectID_; }
+
+protected:
+    void UpdateScript(float timeStep);
+
+    void HandleServerStatus(StringHash eventType, VariantMap& eventData);
+    void HandleClientObjectID(StringHash eventType, VariantMap& eventData);
+
+protected:
+    SharedPtr<Scene> scene_;
+    Network* network_;
+    Server* server_;
+    unsigned index_;
+
+    Controls controls_;
+    float scriptTime_;
+    float swapTime_;
+
+    HiresTimer connectTimer_;
+    float connectTime_;
+    float clientObjectTime_;
+    unsigned clientObjectID_;
+    bool connected_;
+    bool idle_;
+};
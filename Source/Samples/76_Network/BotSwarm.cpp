@@ -0,0 +1,287 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/CoreEvents.h>
+#include <Urho3D/Core/ProcessUtils.h>
+#include <Urho3D/Engine/Engine.h>
+#include <Urho3D/IO/FileSystem.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/Network/Network.h>
+#include <Urho3D/Network/NetworkEvents.h>
+
+#include "BotSwarm.h"
+#include "Server.h"
+#include "NetConditioner.h"
+
+#include <Urho3D/DebugNew.h>
+//=============================================================================
+//=============================================================================
+URHO3D_DEFINE_APPLICATION_MAIN(BotSwarm)
+
+//=============================================================================
+//=============================================================================
+BotSwarm::BotSwarm(Context* context)
+    : Application(context)
+    , address_("localhost")
+    , port_(SERVER_PORT)
+    , numBots_(16)
+    , connectRate_(10.0f)
+    , duration_(0.0f)
+    , reportInterval_(5.0f)
+    , compactTransforms_(false)
+    , slowBots_(0)
+    , slowLatency_(250)
+    , slowLoss_(0.1f)
+    , idleBots_(0.0f)
+    , spawnAcc_(0.0f)
+    , reportAcc_(0.0f)
+    , elapsed_(0.0f)
+{
+}
+
+void BotSwarm::Setup()
+{
+    ParseArguments();
+
+    engineParameters_["LogName"]       = GetSubsystem<FileSystem>()->GetProgramDir() + "netbots.log";
+    engineParameters_["Headless"]      = true;
+    engineParameters_["Sound"]         = false;
+    engineParameters_["ResourcePaths"] = "Data;CoreData;Data/NetDemo;";
+}
+
+void BotSwarm::Start()
+{
+    // a -netseed repeats the bots' controls and their link impairments run to run
+    NetConditioner::SeedRandom(netConditions_.seed_);
+
+    GetSubsystem<Engine>()->SetMaxFps(60);
+
+    SubscribeToEvent(E_UPDATE, URHO3D_HANDLER(BotSwarm, HandleUpdate));
+
+    URHO3D_LOGINFOF("bot swarm: %u bots -> %s:%u at %.1f connects/s", numBots_, address_.CString(), (unsigned)port_, connectRate_);
+}
+
+void BotSwarm::Stop()
+{
+    ReportStats(true);
+
+    for (unsigned i = 0; i < bots_.Size(); ++i)
+    {
+        bots_[i]->Disconnect();
+    }
+
+    // bots must go before the contexts that own their subsystems
+    bots_.Clear();
+    botContexts_.Clear();
+}
+
+void BotSwarm::ParseArguments()
+{
+    const Vector<String>& arguments = GetArguments();
+
+    for (unsigned i = 0; i < arguments.Size(); ++i)
+    {
+        String argument = arguments[i].ToLower();
+
+        // flags
+        if (argument == "-compact")
+        {
+            compactTransforms_ = true;
+            continue;
+        }
+
+        if (i + 1 >= arguments.Size())
+            break;
+
+        const String& value = arguments[i + 1];
+
+        if (argument == "-address")
+        {
+            address_ = value;
+            ++i;
+        }
+        else if (argument == "-port")
+        {
+            port_ = (unsigned short)ToUInt(value);
+            ++i;
+        }
+        else if (argument == "-bots")
+        {
+            numBots_ = ToUInt(value);
+            ++i;
+        }
+        else if (argument == "-connectrate")
+        {
+            connectRate_ = Max(ToFloat(value), 0.1f);
+            ++i;
+        }
+        else if (argument == "-duration")
+        {
+            duration_ = ToFloat(value);
+            ++i;
+        }
+        else if (argument == "-slowbots")
+        {
+            slowBots_ = ToUInt(value);
+            ++i;
+        }
+        else if (argument == "-slowlatency")
+        {
+            slowLatency_ = Max(ToInt(value), 0);
+            ++i;
+        }
+        else if (argument == "-slowloss")
+        {
+            slowLoss_ = Clamp(ToFloat(value), 0.0f, 1.0f);
+            ++i;
+        }
+        else if (argument == "-idlebots")
+        {
+            idleBots_ = Clamp(ToFloat(value), 0.0f, 1.0f);
+            ++i;
+        }
+        else if (argument == "-report")
+        {
+            reportInterval_ = Max(ToFloat(value), 1.0f);
+            ++i;
+        }
+        else if (NetConditioner::ParseArgument(argument, value, netConditions_))
+        {
+            ++i;
+        }
+    }
+}
+
+SharedPtr<Context> BotSwarm::CreateBotContext(bool slowLink)
+{
+    SharedPtr<Context> context = Bot::CreateContext(context_, compactTransforms_);
+    Network* network = context->GetSubsystem<Network>();
+
+    // throttled bots, to check the server backs off their update rate
+    if (slowLink)
+    {
+        network->SetSimulatedLatency(slowLatency_);
+        network->SetSimulatedPacketLoss(slowLoss_);
+    }
+
+    // added to the slow link, the bots share the one random sequence seeded in Start
+    NetConditioner* conditioner = new NetConditioner(context);
+    context->RegisterSubsystem(conditioner);
+    conditioner->SetConditions(netConditions_);
+
+    return context;
+}
+
+void BotSwarm::SpawnBot()
+{
+    SharedPtr<Context> context = CreateBotContext(bots_.Size() < slowBots_);
+    SharedPtr<Bot> bot(new Bot(context, bots_.Size()));
+
+    // idle whenever the running share of idle bots steps up, so 0.8 idles four of every five
+    unsigned index = bots_.Size();
+    bot->SetIdle(FloorToInt((index + 1) * idleBots_) > FloorToInt(index * idleBots_));
+
+    botContexts_.Push(context);
+    bots_.Push(bot);
+
+    bot->Connect(address_, port_);
+}
+
+void BotSwarm::ReportStats(bool final)
+{
+    unsigned numConnected = 0;
+    unsigned numSpawned = 0;
+    float connectSum = 0.0f, connectMax = 0.0f;
+    float objectSum = 0.0f, objectMax = 0.0f;
+    float bytesInSum = 0.0f, bytesOutSum = 0.0f;
+
+    for (unsigned i = 0; i < bots_.Size(); ++i)
+    {
+        Bot* bot = bots_[i];
+
+        if (bot->IsConnected())
+        {
+            ++numConnected;
+            connectSum += bot->GetConnectTime();
+            connectMax = Max(connectMax, bot->GetConnectTime());
+        }
+
+        // steady-state bandwidth only counts bots that have spawned
+        if (bot->HasClientObject())
+        {
+            ++numSpawned;
+            objectSum += bot->GetClientObjectTime();
+            objectMax = Max(objectMax, bot->GetClientObjectTime());
+            bytesInSum += bot->GetBytesInPerSec();
+            bytesOutSum += bot->GetBytesOutPerSec();
+        }
+    }
+
+    String line = ToString("%sbots=%u connected=%u spawned=%u connect avg=%.1fms max=%.1fms clientobjectid avg=%.1fms max=%.1fms "
+        "per bot in=%.0fB/s out=%.0fB/s",
+        final ? "final: " : "", bots_.Size(), numConnected, numSpawned,
+        numConnected ? connectSum / numConnected : 0.0f, connectMax,
+        numSpawned ? objectSum / numSpawned : 0.0f, objectMax,
+        numSpawned ? bytesInSum / numSpawned : 0.0f,
+        numSpawned ? bytesOutSum / numSpawned : 0.0f);
+
+    PrintLine(line);
+    URHO3D_LOGINFO(line);
+}
+
+void BotSwarm::HandleUpdate(StringHash eventType, VariantMap& eventData)
+{
+    using namespace Update;
+    float timeStep = eventData[P_TIMESTEP].GetFloat();
+
+    elapsed_ += timeStep;
+
+    // ramp up connections at a fixed rate so the point where the server starts slipping is visible
+    if (bots_.Size() < numBots_)
+    {
+        spawnAcc_ += timeStep * connectRate_;
+
+        while (spawnAcc_ >= 1.0f && bots_.Size() < numBots_)
+        {
+            SpawnBot();
+            spawnAcc_ -= 1.0f;
+        }
+    }
+
+    for (unsigned i = 0; i < bots_.Size(); ++i)
+    {
+        bots_[i]->Update(timeStep);
+    }
+
+    reportAcc_ += timeStep;
+    if (reportAcc_ >= reportInterval_)
+    {
+        ReportStats(false);
+        reportAcc_ = 0.0f;
+    }
+
+    if (duration_ > 0.0f && elapsed_ >= duration_)
+    {
+        engine_->Exit();
+    }
+}
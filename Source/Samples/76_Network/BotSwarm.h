@@ -0,0 +1,78 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include <Urho3D/Engine/Application.h>
+
+#include "Bot.h"
+#include "NetConditioner.h"
+
+using namespace Urho3D;
+//=============================================================================
+//=============================================================================
+/// Headless load generator, opens N client connections to a server and drives them with scripted input.
+/// usage: 76_Network_Bots [-address <host>] [-port <n>] [-bots <n>] [-connectrate <n/s>] [-duration <s>] [-report <s>]
+///        [-compact] [-slowbots <n>] [-slowlatency <ms>] [-slowloss <0-1>] [-idlebots <0-1>]
+class BotSwarm : public Application
+{
+    URHO3D_OBJECT(BotSwarm, Application);
+
+public:
+    BotSwarm(Context* context);
+
+    virtual void Setup();
+    virtual void Start();
+    virtual void Stop();
+
+protected:
+    void ParseArguments();
+    SharedPtr<Context> CreateBotContext(bool slowLink);
+    void SpawnBot();
+    void ReportStats(bool final);
+
+    void HandleUpdate(StringHash eventType, VariantMap& eventData);
+
+protected:
+    Vector<SharedPtr<Context> > botContexts_;
+    Vector<SharedPtr<Bot> > bots_;
+
+    String address_;
+    unsigned short port_;
+    unsigned numBots_;
+    float connectRate_;
+    float duration_;
+    float reportInterval_;
+    bool compactTransforms_;
+    /// The first slowBots_ bots simulate a poor link.
+    unsigned slowBots_;
+    int slowLatency_;
+    float slowLoss_;
+    /// Fraction of the bots that connect and then sit idle, spread evenly over the bots.
+    float idleBots_;
+    /// Simulated impairments of what every bot sends, on top of the slow link.
+    NetConditions netConditions_;
+
+    float spawnAcc_;
+    float reportAcc_;
+    float elapsed_;
+};
@@ -29,6 +29,7 @@
 #include <Urho3D/Input/Controls.h>
 
 #include "ClientObj.h"
+#include "SnapshotInterpolator.h"
 
 #include <Urho3D/DebugNew.h>
 //=============================================================================
@@ -37,6 +38,17 @@ ClientObj::ClientObj(Context *context)
     : LogicComponent(context)
     , userName_("Client1")
     , colorIdx_(0)
+    , slot_(M_MAX_UNSIGNED)
+    , netDirty_(false)
+    , dormancyTime_(0.0f)
+    , idleTime_(0.0f)
+    , dormant_(false)
+    , dormancyChanged_(false)
+    , inputAck_(0)
+    , predicted_(false)
+    , predictionError_(0.0f)
+    , maxPredictionError_(0.0f)
+    , numCorrections_(0)
 {
 }
 
@@ -50,6 +62,173 @@ void ClientObj::RegisterObject(Context* context)
 
     URHO3D_ATTRIBUTE("Name", String, userName_, String::EMPTY, AM_DEFAULT);
     URHO3D_ATTRIBUTE("Color Index", int, colorIdx_, 0, AM_DEFAULT | AM_NET);
+    // registered ahead of the transform so a client sees the ack that goes with it first
+    URHO3D_ATTRIBUTE("Input Ack", unsigned, inputAck_, 0, AM_NET | AM_LATESTDATA | AM_NOEDIT);
+    URHO3D_ACCESSOR_ATTRIBUTE("Net Transform", GetNetTransformAttr, SetNetTransformAttr, PODVector<unsigned char>, Variant::emptyBuffer, AM_NET | AM_LATESTDATA | AM_NOEDIT);
+}
+
+const TransformCodec& ClientObj::GetTransformCodec()
+{
+    static TransformCodec codec;
+    return codec;
+}
+
+bool ClientObj::UpdateNetTransform(float serverTime, bool keyFrame)
+{
+    TransformState state;
+    GetTransformState(state);
+
+    const TransformCodec& codec = GetTransformCodec();
+
+    if (!transformWriter_.Write(codec, codec.Quantize(state), serverTime, netTransform_, keyFrame))
+        return false;
+
+    MarkNetworkUpdate();
+    return true;
+}
+
+void ClientObj::SetNetTransformAttr(const PODVector<unsigned char>& value)
+{
+    if (value.Empty())
+        return;
+
+    netTransform_.SetData(value);
+
+    const TransformCodec& codec = GetTransformCodec();
+    QuantizedTransform quantized;
+
+    if (!transformReader_.Read(codec, netTransform_, quantized))
+        return;
+
+    if (predicted_)
+    {
+        Reconcile(codec.Dequantize(quantized));
+        return;
+    }
+
+    // remote objects on a smoothing client are shown from the interpolation buffer instead
+    SnapshotInterpolator* interpolator = node_->GetComponent<SnapshotInterpolator>();
+
+    if (interpolator)
+    {
+        interpolator->AddSnapshot(codec.Dequantize(quantized), transformReader_.GetServerTime());
+    }
+    else
+    {
+        ApplyTransformState(codec.Dequantize(quantized));
+    }
+}
+
+void ClientObj::SetPredicted(bool predicted)
+{
+    predicted_ = predicted;
+    predictions_.Clear();
+}
+
+void ClientObj::RecordPrediction(unsigned inputSeq)
+{
+    const unsigned MAX_PREDICTIONS = 64;
+
+    PredictedState prediction;
+    prediction.inputSeq_ = inputSeq;
+    GetTransformState(prediction.state_);
+
+    // the server stopped acking, don't grow without bound
+    if (predictions_.Size() >= MAX_PREDICTIONS)
+    {
+        predictions_.Erase(0);
+    }
+    predictions_.Push(prediction);
+}
+
+void ClientObj::SetInputAck(unsigned inputSeq)
+{
+    if (inputSeq != inputAck_)
+    {
+        inputAck_ = inputSeq;
+        MarkNetworkUpdate();
+    }
+}
+
+void ClientObj::Reconcile(const TransformState& serverState)
+{
+    // anything older than the acked input has been superseded
+    unsigned numOld = 0;
+    while (numOld < predictions_.Size() && predictions_[numOld].inputSeq_ < inputAck_)
+    {
+        ++numOld;
+    }
+    predictions_.Erase(0, numOld);
+
+    // nothing to compare against, e.g. right after spawning, take the server state as is
+    if (predictions_.Empty() || predictions_[0].inputSeq_ != inputAck_)
+    {
+        ApplyTransformState(serverState);
+        return;
+    }
+
+    const float PREDICTION_TOLERANCE = 0.25f;
+    const TransformState& predicted = predictions_[0].state_;
+
+    predictionError_ = (serverState.position_ - predicted.position_).Length();
+    maxPredictionError_ = Max(maxPredictionError_, predictionError_);
+
+    if (predictionError_ <= PREDICTION_TOLERANCE)
+        return;
+
+    // The physics world can't re-simulate one body, so rewind to the server state and re-apply the motion predicted
+    // since the acked input on top of it. Pending predictions move by the same correction
+    const Vector3 positionDelta = serverState.position_ - predicted.position_;
+    const Quaternion rotationDelta = serverState.rotation_ * predicted.rotation_.Inverse();
+    const Vector3 linearDelta = serverState.linearVelocity_ - predicted.linearVelocity_;
+    const Vector3 angularDelta = serverState.angularVelocity_ - predicted.angularVelocity_;
+
+    for (unsigned i = 0; i < predictions_.Size(); ++i)
+    {
+        TransformState& state = predictions_[i].state_;
+        state.position_ += positionDelta;
+        state.rotation_ = (rotationDelta * state.rotation_).Normalized();
+        state.linearVelocity_ += linearDelta;
+        state.angularVelocity_ += angularDelta;
+    }
+
+    TransformState corrected;
+    GetTransformState(corrected);
+    corrected.position_ += positionDelta;
+    corrected.rotation_ = (rotationDelta * corrected.rotation_).Normalized();
+    corrected.linearVelocity_ += linearDelta;
+    corrected.angularVelocity_ += angularDelta;
+    ApplyTransformState(corrected);
+
+    ++numCorrections_;
+}
+
+void ClientObj::GetTransformState(TransformState& state) const
+{
+    state.position_ = node_->GetWorldPosition();
+    state.rotation_ = node_->GetWorldRotation();
+}
+
+void ClientObj::ApplyTransformState(const TransformState& state)
+{
+    node_->SetWorldPosition(state.position_);
+    node_->SetWorldRotation(state.rotation_);
+}
+
+void ClientObj::OnNodeSet(Node* node)
+{
+    LogicComponent::OnNodeSet(node);
+
+    // listen for transform changes
+    if (node)
+    {
+        node->AddListener(this);
+    }
+}
+
+void ClientObj::OnMarkedDirty(Node* node)
+{
+    netDirty_ = true;
 }
 
 void ClientObj::SetClientInfo(const String &usrName, int colorIdx)
@@ -58,6 +237,40 @@ void ClientObj::SetClientInfo(const String &usrName, int colorIdx)
     colorIdx_ = colorIdx;
 }
 
+void ClientObj::ResetState()
+{
+    controls_ = Controls();
+    slot_ = M_MAX_UNSIGNED;
+    netDirty_ = false;
+
+    dormancyTime_ = 0.0f;
+    idleTime_ = 0.0f;
+    dormant_ = false;
+    dormancyChanged_ = false;
+
+    // a new stream for whoever gets this object next
+    netTransform_.Clear();
+    transformWriter_ = TransformStreamWriter();
+    transformReader_ = TransformStreamReader();
+
+    predictions_.Clear();
+    inputAck_ = 0;
+    predicted_ = false;
+    predictionError_ = 0.0f;
+    maxPredictionError_ = 0.0f;
+    numCorrections_ = 0;
+}
+
+void ClientObj::SetDormant(bool dormant)
+{
+    if (dormant == dormant_)
+        return;
+
+    dormant_ = dormant;
+    dormancyChanged_ = true;
+    idleTime_ = 0.0f;
+}
+
 void ClientObj::ClearControls()
 {
     controls_.buttons_ = 0;
@@ -25,12 +25,24 @@
 #include <Urho3D/Scene/LogicComponent.h>
 #include <Urho3D/Core/Variant.h>
 #include <Urho3D/Input/Controls.h>
+#include <Urho3D/IO/VectorBuffer.h>
+
+#include "TransformCodec.h"
 
 namespace Urho3D
 {
 class Scene;
 }
 using namespace Urho3D;
+//=============================================================================
+//=============================================================================
+/// Client: locally predicted state after sending an input.
+struct PredictedState
+{
+    unsigned inputSeq_;
+    TransformState state_;
+};
+
 //=============================================================================
 //=============================================================================
 class ClientObj : public LogicComponent
@@ -44,12 +56,100 @@ public:
 
     virtual void Create(){}
     virtual void SetClientInfo(const String &usrName, int colorIdx);
+    const String& GetUserName() const { return userName_; }
+    int GetColorIdx() const { return colorIdx_; }
     virtual void SetControls(const Controls &controls);
     virtual void ClearControls();
+    /// Return to a freshly created state, for reuse by another client.
+    virtual void ResetState();
+
+    void SetSlot(unsigned slot) { slot_ = slot; }
+    unsigned GetSlot() const { return slot_; }
+
+    /// Server: encode the current transform, taken at serverTime, into the compact stream, returns whether it changed.
+    /// Force a key frame when the stream goes quiet after this.
+    bool UpdateNetTransform(float serverTime, bool keyFrame = false);
+    /// Client: decode the compact stream.
+    void SetNetTransformAttr(const PODVector<unsigned char>& value);
+    const PODVector<unsigned char>& GetNetTransformAttr() const { return netTransform_.GetBuffer(); }
+    static const TransformCodec& GetTransformCodec();
+
+    /// Client: predict this object locally from its own inputs and reconcile against the server's compact stream.
+    void SetPredicted(bool predicted);
+    bool IsPredicted() const { return predicted_; }
+    /// Client: record the predicted state after an input was sent.
+    void RecordPrediction(unsigned inputSeq);
+    /// Server: echo the sequence number of the last input applied.
+    void SetInputAck(unsigned inputSeq);
+    unsigned GetInputAck() const { return inputAck_; }
+
+    /// Prediction metrics, error is the position distance between the predicted and the server state.
+    float GetPredictionError() const { return predictionError_; }
+    float GetMaxPredictionError() const { return maxPredictionError_; }
+    unsigned GetNumCorrections() const { return numCorrections_; }
+
+    /// Set the node (and body) to a decoded state.
+    virtual void ApplyTransformState(const TransformState& state);
+    virtual void GetTransformState(TransformState& state) const;
+
+    /// Server: go dormant after this many seconds with no buttons held and a resting body, 0 never.
+    void SetDormancyTime(float seconds) { dormancyTime_ = seconds; }
+    float GetDormancyTime() const { return dormancyTime_; }
+    /// Server: a dormant object is left out of movement, physics and transform updates until input or a collision
+    /// wakes it.
+    virtual void SetDormant(bool dormant);
+    bool IsDormant() const { return dormant_; }
+    /// Server: add a tick's idle time, or start over when not idle. Returns true once it's time to go dormant.
+    bool UpdateIdle(float timeStep, bool idle)
+    {
+        idleTime_ = idle ? idleTime_ + timeStep : 0.0f;
+        return dormancyTime_ > 0.0f && idleTime_ >= dormancyTime_;
+    }
+    /// Return whether the object went dormant or woke since the last call, and clear the flag.
+    bool ConsumeDormancyChanged()
+    {
+        bool changed = dormancyChanged_;
+        dormancyChanged_ = false;
+        return changed;
+    }
+
+    /// Return whether the node moved since the last call, and clear the flag.
+    bool ConsumeNetDirty()
+    {
+        bool dirty = netDirty_;
+        netDirty_ = false;
+        return dirty;
+    }
+
+protected:
+    virtual void OnNodeSet(Node* node);
+    virtual void OnMarkedDirty(Node* node);
+    void Reconcile(const TransformState& serverState);
 
 protected:
     Controls controls_;
     String userName_;
     int colorIdx_;
+    unsigned slot_;
+    bool netDirty_;
+
+    /// Dormancy.
+    float dormancyTime_;
+    float idleTime_;
+    bool dormant_;
+    bool dormancyChanged_;
+
+    /// Compact transform stream.
+    VectorBuffer netTransform_;
+    TransformStreamWriter transformWriter_;
+    TransformStreamReader transformReader_;
+
+    /// Prediction.
+    Vector<PredictedState> predictions_;
+    unsigned inputAck_;
+    bool predicted_;
+    float predictionError_;
+    float maxPredictionError_;
+    unsigned numCorrections_;
 };
 
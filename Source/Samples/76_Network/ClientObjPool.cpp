@@ -0,0 +1,114 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <Urho3D/Scene/Scene.h>
+
+#include "ClientObjPool.h"
+#include "ClientObj.h"
+
+#include <Urho3D/DebugNew.h>
+//=============================================================================
+//=============================================================================
+ClientObjPool::ClientObjPool()
+    : numInUse_(0)
+    , numHits_(0)
+    , numMisses_(0)
+    , highWaterMark_(0)
+{
+}
+
+ClientObjPool::~ClientObjPool()
+{
+}
+
+Node* ClientObjPool::CreateNode(Scene *scene, StringHash clientHash)
+{
+    Node* clientNode = scene->CreateChild("client");
+    clientNode->CreateComponent(clientHash);
+    return clientNode;
+}
+
+void ClientObjPool::Reserve(Scene *scene, StringHash clientHash, unsigned count)
+{
+    for (unsigned i = 0; i < count; ++i)
+    {
+        // create in the scene so every component is set up, then take it straight back out before it's replicated
+        SharedPtr<Node> clientNode(CreateNode(scene, clientHash));
+        clientNode->GetDerivedComponent<ClientObj>()->Create();
+        clientNode->GetDerivedComponent<ClientObj>()->ResetState();
+        clientNode->Remove();
+
+        free_.Push(clientNode);
+    }
+}
+
+Node* ClientObjPool::Acquire(Scene *scene, StringHash clientHash)
+{
+    Node* clientNode;
+
+    if (free_.Size())
+    {
+        clientNode = free_.Back();
+        scene->AddChild(clientNode);
+        free_.Pop();
+        ++numHits_;
+    }
+    else
+    {
+        clientNode = CreateNode(scene, clientHash);
+        ++numMisses_;
+    }
+
+    highWaterMark_ = Max(highWaterMark_, ++numInUse_);
+    return clientNode;
+}
+
+void ClientObjPool::Release(Node *node)
+{
+    SharedPtr<Node> clientNode(node);
+
+    ClientObj* clientObj = clientNode->GetDerivedComponent<ClientObj>();
+    if (clientObj)
+    {
+        clientObj->ResetState();
+    }
+
+    clientNode->SetOwner(NULL);
+    clientNode->Remove();
+
+    free_.Push(clientNode);
+
+    if (numInUse_)
+    {
+        --numInUse_;
+    }
+}
+
+void ClientObjPool::Clear()
+{
+    free_.Clear();
+    numInUse_ = 0;
+    numHits_ = 0;
+    numMisses_ = 0;
+    highWaterMark_ = 0;
+}
@@ -0,0 +1,72 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include <Urho3D/Container/Ptr.h>
+#include <Urho3D/Container/Vector.h>
+#include <Urho3D/Math/StringHash.h>
+
+namespace Urho3D
+{
+class Node;
+class Scene;
+}
+
+using namespace Urho3D;
+//=============================================================================
+//=============================================================================
+/// Server: recycles client object nodes across joins. Free nodes are kept out of the scene, so they are neither
+/// replicated nor simulated, and keep their components (model, body, shape, name tag) for the next client.
+class ClientObjPool
+{
+public:
+    ClientObjPool();
+    ~ClientObjPool();
+
+    /// Pre-create count client objects of the given type. The scene needs its physics world.
+    void Reserve(Scene *scene, StringHash clientHash, unsigned count);
+    /// Return a client object node added to the scene, from the pool if there is one free. Its client object needs
+    /// SetClientInfo and Create before use.
+    Node* Acquire(Scene *scene, StringHash clientHash);
+    /// Take a node back out of the scene, its client object is reset.
+    void Release(Node *node);
+    /// Destroy the free nodes and reset the counters.
+    void Clear();
+
+    unsigned GetNumFree() const { return free_.Size(); }
+    unsigned GetNumInUse() const { return numInUse_; }
+    unsigned GetNumHits() const { return numHits_; }
+    unsigned GetNumMisses() const { return numMisses_; }
+    /// Most client objects in use at once.
+    unsigned GetHighWaterMark() const { return highWaterMark_; }
+
+private:
+    Node* CreateNode(Scene *scene, StringHash clientHash);
+
+    Vector<SharedPtr<Node> > free_;
+    unsigned numInUse_;
+    unsigned numHits_;
+    unsigned numMisses_;
+    unsigned highWaterMark_;
+};
@@ -0,0 +1,101 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Graphics/Model.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/Physics/CollisionShape.h>
+#include <Urho3D/Physics/PhysicsWorld.h>
+#include <Urho3D/Resource/ResourceEvents.h>
+#include <Urho3D/Scene/Scene.h>
+
+#include "CollisionMeshCache.h"
+
+#include <Urho3D/DebugNew.h>
+//=============================================================================
+//=============================================================================
+CollisionMeshCache::CollisionMeshCache(Context* context)
+    : Object(context)
+    , numHits_(0)
+    , numMisses_(0)
+    , cookTime_(0.0f)
+    , savedTime_(0.0f)
+{
+}
+
+CollisionMeshCache::~CollisionMeshCache()
+{
+}
+
+void CollisionMeshCache::SetTriangleMesh(CollisionShape* shape, Model* model)
+{
+    PhysicsWorld* physicsWorld = shape->GetScene()->GetComponent<PhysicsWorld>();
+    Pair<Model*, unsigned> key = MakePair(model, 0U);
+    HashMap<Pair<Model*, unsigned>, SharedPtr<CollisionGeometryData> >& worldCache = physicsWorld->GetTriMeshCache();
+    HashMap<Model*, Entry>::Iterator it = entries_.Find(model);
+
+    // seed the world's cache, the shape then picks the cooked data up instead of building it
+    if (it != entries_.End())
+    {
+        worldCache[key] = it->second_.geometry_;
+        shape->SetTriangleMesh(model);
+
+        ++numHits_;
+        savedTime_ += it->second_.cookTime_;
+        return;
+    }
+
+    HiresTimer timer;
+    shape->SetTriangleMesh(model);
+    float elapsed = timer.GetUSec(false) / 1000.0f;
+
+    HashMap<Pair<Model*, unsigned>, SharedPtr<CollisionGeometryData> >::Iterator cooked = worldCache.Find(key);
+    if (cooked == worldCache.End())
+        return;
+
+    Entry& entry = entries_[model];
+    entry.model_ = model;
+    entry.geometry_ = cooked->second_;
+    entry.cookTime_ = elapsed;
+
+    ++numMisses_;
+    cookTime_ += elapsed;
+    SubscribeToEvent(model, E_RELOADFINISHED, URHO3D_HANDLER(CollisionMeshCache, HandleModelReloaded));
+
+    URHO3D_LOGINFOF("cooked collision mesh %s in %.1fms", model->GetName().CString(), elapsed);
+}
+
+void CollisionMeshCache::Clear()
+{
+    UnsubscribeFromAllEvents();
+    entries_.Clear();
+}
+
+void CollisionMeshCache::HandleModelReloaded(StringHash eventType, VariantMap& eventData)
+{
+    // the geometry changed, the next shape cooks it again
+    Model* model = static_cast<Model*>(GetEventSender());
+
+    entries_.Erase(model);
+    UnsubscribeFromEvent(model, E_RELOADFINISHED);
+}
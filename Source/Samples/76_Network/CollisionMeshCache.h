@@ -0,0 +1,82 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include <Urho3D/Core/Object.h>
+
+namespace Urho3D
+{
+class CollisionGeometryData;
+class CollisionShape;
+class Model;
+}
+
+using namespace Urho3D;
+//=============================================================================
+//=============================================================================
+/// Keeps the cooked triangle mesh collision data (the Bullet BVH) of static level models alive across scenes. The
+/// physics world only caches geometry while a shape uses it, so without this every new scene, including the one the
+/// sample rebuilds on disconnect, builds the BVH again. A model's entry is dropped when the model is reloaded.
+///
+/// The cache lives in memory only, a cold start still cooks each model once. Loading a BVH saved to disk would need
+/// the engine to accept one: TriangleMeshData always builds its BVH in its constructor, and CollisionShape casts
+/// whatever the physics world caches to TriangleMeshData, so a deserialized btOptimizedBvh can't be handed to it.
+class CollisionMeshCache : public Object
+{
+    URHO3D_OBJECT(CollisionMeshCache, Object);
+
+public:
+    CollisionMeshCache(Context* context);
+    virtual ~CollisionMeshCache();
+
+    /// Same as CollisionShape::SetTriangleMesh, reusing the cooked data if this model was cooked before. The shape
+    /// must already be in a scene with a physics world.
+    void SetTriangleMesh(CollisionShape* shape, Model* model);
+    void Clear();
+
+    unsigned GetNumHits() const { return numHits_; }
+    unsigned GetNumMisses() const { return numMisses_; }
+    /// Total time spent cooking, and the cooking time reuse has saved.
+    float GetCookTime() const { return cookTime_; }
+    float GetSavedTime() const { return savedTime_; }
+
+protected:
+    void HandleModelReloaded(StringHash eventType, VariantMap& eventData);
+
+protected:
+    struct Entry
+    {
+        /// Pinned so the key can't be reused by another model.
+        SharedPtr<Model> model_;
+        SharedPtr<CollisionGeometryData> geometry_;
+        /// Time the cook took, ms.
+        float cookTime_;
+    };
+
+    HashMap<Model*, Entry> entries_;
+    unsigned numHits_;
+    unsigned numMisses_;
+    float cookTime_;
+    float savedTime_;
+};
@@ -0,0 +1,403 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <Urho3D/Core/CoreEvents.h>
+#include <Urho3D/Core/ProcessUtils.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Engine/Engine.h>
+#include <Urho3D/Graphics/Model.h>
+#include <Urho3D/Input/Controls.h>
+#include <Urho3D/IO/FileSystem.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/Network/Network.h>
+#include <Urho3D/Network/NetworkEvents.h>
+#include <Urho3D/Physics/CollisionShape.h>
+#include <Urho3D/Physics/PhysicsEvents.h>
+#include <Urho3D/Physics/PhysicsWorld.h>
+#include <Urho3D/Physics/RigidBody.h>
+#include <Urho3D/Resource/ResourceCache.h>
+#include <Urho3D/Scene/Scene.h>
+
+#include "DedicatedServer.h"
+#include "Server.h"
+#include "ClientObj.h"
+#include "Baller.h"
+#include "NetStats.h"
+#include "NetConditioner.h"
+#include "TickProfiler.h"
+#include "BallerSystem.h"
+#include "MaterialPalette.h"
+#include "CollisionMeshCache.h"
+#include "ResourcePreloader.h"
+
+#include <Urho3D/DebugNew.h>
+//=============================================================================
+//=============================================================================
+URHO3D_DEFINE_APPLICATION_MAIN(DedicatedServer)
+
+DedicatedServer::DedicatedServer(Context* context)
+    : Application(context)
+    , port_(SERVER_PORT)
+    , tickRate_(60)
+    , updateRate_(0)
+    , minUpdateInterval_(1)
+    , maxUpdateInterval_(1)
+    , maxClients_(64)
+    , maxStreaming_(8)
+    , poolSize_(0)
+    , statsInterval_(5.0f)
+    , interestRadius_(0.0f)
+    , lagCompensation_(0.0f)
+    , maxViewDelay_(0.25f)
+    , dormancyTime_(0.0f)
+    , tickBudget_(-1.0f)
+    , flightRecorderTime_(10.0f)
+    , compactTransforms_(false)
+    , threadedSimulation_(false)
+    , numRooms_(1)
+    , numSimulationThreads_(0)
+{
+}
+
+void DedicatedServer::Setup()
+{
+    ParseArguments();
+
+    engineParameters_["LogName"]       = GetSubsystem<FileSystem>()->GetProgramDir() + "netserver.log";
+    engineParameters_["Headless"]      = true;
+    engineParameters_["Sound"]         = false;
+    engineParameters_["ResourcePaths"] = "Data;CoreData;Data/NetDemo;";
+}
+
+void DedicatedServer::Start()
+{
+    // rand seed, or a -netseed to repeat the link impairments
+    NetConditioner::SeedRandom(netConditions_.seed_);
+
+    // no rendering to pace the frame loop, so let the engine sleep between ticks
+    GetSubsystem<Engine>()->SetMaxFps(tickRate_);
+    GetSubsystem<Network>()->SetUpdateFps(updateRate_ ? updateRate_ : tickRate_);
+
+    CreateServerSubsystem();
+
+    // stream the level and ball resources in on the background threads, the server starts once they're in
+    preloader_ = new ResourcePreloader(context_);
+    SubscribeToEvent(preloader_, E_PRELOADFINISHED, URHO3D_HANDLER(DedicatedServer, HandlePreloadFinished));
+    preloader_->LoadManifest("NetDemo/Preload.xml");
+}
+
+void DedicatedServer::HandlePreloadFinished(StringHash eventType, VariantMap& eventData)
+{
+    GetSubsystem<MaterialPalette>()->Load();
+
+    CreateScene();
+
+    SubscribeToEvents();
+
+    Server *server = GetSubsystem<Server>();
+    server->SetMaxClients(maxClients_);
+    server->SetMaxStreamingClients(maxStreaming_);
+    server->SetClientPoolSize(poolSize_);
+    server->SetInterestRadius(interestRadius_);
+    server->SetLagCompensation(lagCompensation_);
+    server->SetMaxInterpolationDelay(maxViewDelay_);
+    server->SetDormancyTime(dormancyTime_);
+    server->SetUpdateIntervalRange(minUpdateInterval_, maxUpdateInterval_);
+    server->SetCompactTransforms(compactTransforms_);
+    // rooms are simulated concurrently on the thread pool, by default a thread per core but the main thread's
+    unsigned numThreads = numSimulationThreads_ ? numSimulationThreads_ : Max(GetNumPhysicalCPUs(), 2U) - 1;
+    server->SetThreadedSimulation(threadedSimulation_ || numRooms_ > 1, numThreads);
+
+    if (!server->StartServer(port_))
+    {
+        ErrorExit(ToString("Failed to start server on port %u", (unsigned)port_));
+        return;
+    }
+
+    if (!recordFile_.Empty())
+    {
+        server->StartInputRecording(recordFile_);
+    }
+
+    URHO3D_LOGINFOF("dedicated server listening on port %u, tick rate=%i, max clients=%u, startup %.1fms",
+        (unsigned)port_, tickRate_, maxClients_, startupTimer_.GetUSec(false) / 1000.0f);
+}
+
+void DedicatedServer::Stop()
+{
+    Server *server = GetSubsystem<Server>();
+    const ClientObjPool& pool = server->GetClientObjPool();
+
+    URHO3D_LOGINFOF("client object pool: hits=%u misses=%u high water=%u free=%u",
+        pool.GetNumHits(), pool.GetNumMisses(), pool.GetHighWaterMark(), pool.GetNumFree());
+
+    static const char* joinStageNames[MAX_JOINHIST] = { "queued", "streaming", "snapshot", "total" };
+    for (unsigned i = 0; i < MAX_JOINHIST; ++i)
+    {
+        URHO3D_LOGINFOF("join %s: %s", joinStageNames[i], server->GetJoinHistogram((JoinHistogram)i).ToString().CString());
+    }
+
+    const InputStats& inputStats = server->GetInputStats();
+    URHO3D_LOGINFOF("client inputs: received=%u recovered from redundant copies=%u lost=%u",
+        inputStats.received_, inputStats.recovered_, inputStats.lost_);
+
+    if (server->GetDormancyTime() > 0.0f)
+    {
+        URHO3D_LOGINFOF("dormant client objects: %u of %u", server->GetNumDormantClients(), server->GetNumClients());
+    }
+
+    server->Disconnect();
+
+    URHO3D_LOGINFOF("tick jitter (%s): %s", server->GetThreadedSimulation() ? "simulation threads" : "frame loop",
+        server->GetTickJitter().ToString().CString());
+
+    GetSubsystem<TickProfiler>()->LogSummary();
+}
+
+void DedicatedServer::ParseArguments()
+{
+    // usage: 76_Network_Server [-port <n>] [-tickrate <n>] [-updaterate <n>] [-maxclients <n>] [-maxstreaming <n>] [-pool <n>] [-stats <file.csv|file.json>] [-statsinterval <s>]
+    //        [-interest <radius>] [-compact] [-mininterval <n>] [-maxinterval <n>] [-record <file>]
+    //        [-threaded] [-rooms <n>] [-simthreads <n>] [-lagcomp <s>] [-maxviewdelay <s>] [-tickbudget <ms>] [-flightrecorder <s>] [-dormancy <s>]
+    //        [-netlatency <ms>] [-netjitter <ms>] [-netloss <0-1>] [-netdup <0-1>] [-netbandwidth <bytes/s>] [-netqueue <ms>] [-netseed <n>]
+    const Vector<String>& arguments = GetArguments();
+
+    for (unsigned i = 0; i < arguments.Size(); ++i)
+    {
+        String argument = arguments[i].ToLower();
+
+        // flags
+        if (argument == "-compact")
+        {
+            compactTransforms_ = true;
+            continue;
+        }
+        if (argument == "-threaded")
+        {
+            threadedSimulation_ = true;
+            continue;
+        }
+
+        if (i + 1 >= arguments.Size())
+            break;
+
+        const String& value = arguments[i + 1];
+
+        if (argument == "-port")
+        {
+            port_ = (unsigned short)ToUInt(value);
+            ++i;
+        }
+        else if (argument == "-tickrate")
+        {
+            tickRate_ = Max(ToInt(value), 1);
+            ++i;
+        }
+        else if (argument == "-updaterate")
+        {
+            updateRate_ = Max(ToInt(value), 1);
+            ++i;
+        }
+        else if (argument == "-pool")
+        {
+            poolSize_ = ToUInt(value);
+            ++i;
+        }
+        else if (argument == "-maxclients")
+        {
+            maxClients_ = ToUInt(value);
+            ++i;
+        }
+        else if (argument == "-maxstreaming")
+        {
+            maxStreaming_ = ToUInt(value);
+            ++i;
+        }
+        else if (argument == "-stats")
+        {
+            statsFile_ = value;
+            ++i;
+        }
+        else if (argument == "-rooms")
+        {
+            numRooms_ = Max(ToUInt(value), 1U);
+            ++i;
+        }
+        else if (argument == "-simthreads")
+        {
+            numSimulationThreads_ = Max(ToUInt(value), 1U);
+            ++i;
+        }
+        else if (argument == "-record")
+        {
+            recordFile_ = value;
+            ++i;
+        }
+        else if (argument == "-statsinterval")
+        {
+            statsInterval_ = Max(ToFloat(value), 0.1f);
+            ++i;
+        }
+        else if (argument == "-mininterval")
+        {
+            minUpdateInterval_ = Max(ToUInt(value), 1U);
+            ++i;
+        }
+        else if (argument == "-maxinterval")
+        {
+            maxUpdateInterval_ = Max(ToUInt(value), 1U);
+            ++i;
+        }
+        else if (argument == "-interest")
+        {
+            interestRadius_ = Max(ToFloat(value), 0.0f);
+            ++i;
+        }
+        else if (argument == "-lagcomp")
+        {
+            lagCompensation_ = Max(ToFloat(value), 0.0f);
+            ++i;
+        }
+        else if (argument == "-maxviewdelay")
+        {
+            maxViewDelay_ = Max(ToFloat(value), 0.0f);
+            ++i;
+        }
+        else if (argument == "-dormancy")
+        {
+            dormancyTime_ = Max(ToFloat(value), 0.0f);
+            ++i;
+        }
+        else if (argument == "-tickbudget")
+        {
+            tickBudget_ = Max(ToFloat(value), 0.0f);
+            ++i;
+        }
+        else if (argument == "-flightrecorder")
+        {
+            flightRecorderTime_ = Max(ToFloat(value), 1.0f);
+            ++i;
+        }
+        else if (NetConditioner::ParseArgument(argument, value, netConditions_))
+        {
+            ++i;
+        }
+    }
+}
+
+void DedicatedServer::CreateServerSubsystem()
+{
+    // tick stage histograms and the flight recorder, cheap enough to always run. A tick over its period by default
+    // dumps the recorder next to the log
+    TickProfiler* profiler = new TickProfiler(context_);
+    context_->RegisterSubsystem(profiler);
+    unsigned samplesPerSecond = tickRate_ * numRooms_ + (updateRate_ ? updateRate_ : tickRate_);
+    profiler->SetRecorderLength(flightRecorderTime_, samplesPerSecond);
+    profiler->SetTickBudget(tickBudget_ >= 0.0f ? tickBudget_ : 1000.0f / tickRate_,
+        GetSubsystem<FileSystem>()->GetProgramDir());
+
+    context_->RegisterSubsystem(new Server(context_));
+
+    // simulated link, applied to each client connection as it's accepted
+    NetConditioner* conditioner = new NetConditioner(context_);
+    context_->RegisterSubsystem(conditioner);
+    conditioner->SetConditions(netConditions_);
+
+    // bandwidth and frame stage instrumentation
+    NetStats* netStats = new NetStats(context_);
+    context_->RegisterSubsystem(netStats);
+
+    if (!statsFile_.Empty())
+    {
+        netStats->SetDumpFile(statsFile_, statsInterval_);
+    }
+
+    // ball materials, resolved once preloading is done and before any client object is created
+    context_->RegisterSubsystem(new MaterialPalette(context_));
+
+    // level collision cooked once per process
+    context_->RegisterSubsystem(new CollisionMeshCache(context_));
+
+    // register client objs
+    ClientObj::RegisterObject(context_);
+    Baller::RegisterObject(context_);
+    BallerSystem::RegisterObject(context_);
+}
+
+void DedicatedServer::CreateScene()
+{
+    scene_ = CreateRoomScene();
+
+    // server requires client hash and scene info
+    Server *server = GetSubsystem<Server>();
+    server->RegisterClientHashAndScene(Baller::GetTypeStatic(), scene_);
+
+    // further rooms are copies of the same level, named by number
+    for (unsigned i = 1; i < numRooms_; ++i)
+    {
+        SharedPtr<Scene> roomScene = CreateRoomScene();
+        roomScenes_.Push(roomScene);
+        server->AddRoom(String(i), roomScene);
+    }
+}
+
+SharedPtr<Scene> DedicatedServer::CreateRoomScene()
+{
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
+
+    SharedPtr<Scene> scene(new Scene(context_));
+
+    // Only the physics world is needed on a dedicated server, no octree, zone, light or camera. Create it as local so that
+    // it is not needlessly replicated when a client connects
+    PhysicsWorld *physicsWorld = scene->CreateComponent<PhysicsWorld>(LOCAL);
+    physicsWorld->SetFps(tickRate_);
+    scene->CreateComponent<BallerSystem>(LOCAL);
+
+    // The level only needs its collision, clients create their own visual floor
+    Node* floorNode = scene->CreateChild("floor", LOCAL);
+    Model *model = cache->GetResource<Model>("NetDemo/level1.mdl");
+    floorNode->CreateComponent<RigidBody>();
+    CollisionShape* shape = floorNode->CreateComponent<CollisionShape>();
+    GetSubsystem<CollisionMeshCache>()->SetTriangleMesh(shape, model);
+
+    return scene;
+}
+
+void DedicatedServer::SubscribeToEvents()
+{
+    SubscribeToEvent(E_PHYSICSPRESTEP, URHO3D_HANDLER(DedicatedServer, HandlePhysicsPreStep));
+    SubscribeToEvent(E_CLIENTCONNECTED, URHO3D_HANDLER(DedicatedServer, HandleClientConnected));
+}
+
+void DedicatedServer::HandleClientConnected(StringHash eventType, VariantMap& eventData)
+{
+    URHO3D_LOGINFOF("first connection accepted %.1fms after startup", startupTimer_.GetUSec(false) / 1000.0f);
+
+    // only the first one is of interest
+    UnsubscribeFromEvent(E_CLIENTCONNECTED);
+}
+
+void DedicatedServer::HandlePhysicsPreStep(StringHash eventType, VariantMap& eventData)
+{
+    // server applies the controls received on each client connection, there are no local controls
+    GetSubsystem<Server>()->UpdatePhysicsPreStep(Controls());
+}
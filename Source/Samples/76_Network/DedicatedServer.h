@@ -0,0 +1,108 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include <Urho3D/Engine/Application.h>
+#include <Urho3D/Core/Timer.h>
+
+#include "NetConditioner.h"
+
+namespace Urho3D
+{
+class Scene;
+}
+
+using namespace Urho3D;
+//=============================================================================
+//=============================================================================
+class ResourcePreloader;
+
+//=============================================================================
+//=============================================================================
+class DedicatedServer : public Application
+{
+    URHO3D_OBJECT(DedicatedServer, Application);
+
+public:
+    DedicatedServer(Context* context);
+
+    virtual void Setup();
+    virtual void Start();
+    virtual void Stop();
+
+protected:
+    void ParseArguments();
+    void CreateServerSubsystem();
+    void CreateScene();
+    SharedPtr<Scene> CreateRoomScene();
+    void SubscribeToEvents();
+
+    /// Handle the physics world pre-step event.
+    void HandlePhysicsPreStep(StringHash eventType, VariantMap& eventData);
+    void HandlePreloadFinished(StringHash eventType, VariantMap& eventData);
+    void HandleClientConnected(StringHash eventType, VariantMap& eventData);
+
+protected:
+    SharedPtr<Scene> scene_;
+    /// Scenes of the rooms after the first.
+    Vector<SharedPtr<Scene> > roomScenes_;
+    SharedPtr<ResourcePreloader> preloader_;
+    /// Runs from construction, for startup timings.
+    HiresTimer startupTimer_;
+    unsigned short port_;
+    int tickRate_;
+    /// Network update rate, 0 follows the tick rate.
+    int updateRate_;
+    /// Adaptive per-connection update interval bounds, in network updates.
+    unsigned minUpdateInterval_;
+    unsigned maxUpdateInterval_;
+    unsigned maxClients_;
+    /// Clients streaming the scene at once while joining, 0 is unlimited.
+    unsigned maxStreaming_;
+    /// Client objects pre-created at startup.
+    unsigned poolSize_;
+    String statsFile_;
+    /// Input log for 76_Network_Replay, empty when not recording.
+    String recordFile_;
+    float statsInterval_;
+    float interestRadius_;
+    /// Seconds of client object history kept for lag compensated queries, 0 disables.
+    float lagCompensation_;
+    /// Largest interpolation delay accepted from a client.
+    float maxViewDelay_;
+    /// Idle seconds before a client object goes dormant, 0 never.
+    float dormancyTime_;
+    /// Tick time that dumps the flight recorder, ms, 0 never dumps and below 0 uses the tick period.
+    float tickBudget_;
+    /// Seconds of tick samples the flight recorder holds.
+    float flightRecorderTime_;
+    bool compactTransforms_;
+    /// Simulate on a dedicated thread instead of the frame loop.
+    bool threadedSimulation_;
+    /// Independent rooms hosted, each with its own scene. More than one runs on the simulation threads.
+    unsigned numRooms_;
+    /// Simulation thread pool size, 0 picks from the core count.
+    unsigned numSimulationThreads_;
+    /// Simulated impairments of what the server sends.
+    NetConditions netConditions_;
+};
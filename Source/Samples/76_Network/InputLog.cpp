@@ -0,0 +1,168 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <Urho3D/IO/File.h>
+#include <Urho3D/IO/Log.h>
+
+#include "InputLog.h"
+
+#include <Urho3D/DebugNew.h>
+//=============================================================================
+//=============================================================================
+static const unsigned INPUTLOG_VERSION = 1;
+
+//=============================================================================
+//=============================================================================
+InputLogWriter::InputLogWriter()
+    : numTicks_(0)
+{
+}
+
+InputLogWriter::~InputLogWriter()
+{
+    Close();
+}
+
+bool InputLogWriter::Open(Context* context, const String &fileName, int fps)
+{
+    Close();
+
+    file_ = new File(context, fileName, FILE_WRITE);
+    if (!file_->IsOpen())
+    {
+        URHO3D_LOGERRORF("could not open input log %s", fileName.CString());
+        file_.Reset();
+        return false;
+    }
+
+    file_->WriteFileID("NIRL");
+    file_->WriteUInt(INPUTLOG_VERSION);
+    file_->WriteInt(fps);
+    numTicks_ = 0;
+
+    return true;
+}
+
+void InputLogWriter::Close()
+{
+    if (file_)
+    {
+        file_->Close();
+        file_.Reset();
+    }
+}
+
+void InputLogWriter::WriteJoin(unsigned clientId, const String &userName, int colorIdx, const Vector3 &position)
+{
+    file_->WriteUByte(INPUTREC_JOIN);
+    file_->WriteVLE(clientId);
+    file_->WriteString(userName);
+    file_->WriteInt(colorIdx);
+    file_->WriteVector3(position);
+}
+
+void InputLogWriter::WriteLeave(unsigned clientId)
+{
+    file_->WriteUByte(INPUTREC_LEAVE);
+    file_->WriteVLE(clientId);
+}
+
+void InputLogWriter::BeginTick(unsigned numClients)
+{
+    file_->WriteUByte(INPUTREC_TICK);
+    file_->WriteVLE(numClients);
+    ++numTicks_;
+}
+
+void InputLogWriter::WriteControls(unsigned clientId, const Controls &controls)
+{
+    file_->WriteVLE(clientId);
+    file_->WriteVLE(controls.buttons_);
+    file_->WriteFloat(controls.yaw_);
+}
+
+//=============================================================================
+//=============================================================================
+InputLogReader::InputLogReader()
+    : fps_(0)
+{
+}
+
+InputLogReader::~InputLogReader()
+{
+}
+
+bool InputLogReader::Open(Context* context, const String &fileName)
+{
+    file_ = new File(context, fileName, FILE_READ);
+    if (!file_->IsOpen() || file_->ReadFileID() != "NIRL" || file_->ReadUInt() != INPUTLOG_VERSION)
+    {
+        URHO3D_LOGERRORF("%s is not an input log", fileName.CString());
+        file_.Reset();
+        return false;
+    }
+
+    fps_ = file_->ReadInt();
+    return true;
+}
+
+bool InputLogReader::Read(InputLogRecord& record)
+{
+    if (!file_ || file_->IsEof())
+        return false;
+
+    record.type_ = (InputRecordType)file_->ReadUByte();
+
+    switch (record.type_)
+    {
+    case INPUTREC_JOIN:
+        record.clientId_ = file_->ReadVLE();
+        record.userName_ = file_->ReadString();
+        record.colorIdx_ = file_->ReadInt();
+        record.position_ = file_->ReadVector3();
+        break;
+
+    case INPUTREC_LEAVE:
+        record.clientId_ = file_->ReadVLE();
+        break;
+
+    case INPUTREC_TICK:
+        {
+            unsigned count = file_->ReadVLE();
+            record.controls_.Resize(count);
+            for (unsigned i = 0; i < count; ++i)
+            {
+                record.controls_[i].clientId_ = file_->ReadVLE();
+                record.controls_[i].buttons_ = file_->ReadVLE();
+                record.controls_[i].yaw_ = file_->ReadFloat();
+            }
+        }
+        break;
+
+    default:
+        URHO3D_LOGERRORF("malformed input log record type %u", (unsigned)record.type_);
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,122 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include <Urho3D/Container/Ptr.h>
+#include <Urho3D/Input/Controls.h>
+#include <Urho3D/Math/Vector3.h>
+
+namespace Urho3D
+{
+class Context;
+class File;
+}
+
+using namespace Urho3D;
+//=============================================================================
+//=============================================================================
+enum InputRecordType
+{
+    INPUTREC_NONE = 0,
+    INPUTREC_JOIN,
+    INPUTREC_LEAVE,
+    INPUTREC_TICK,
+};
+
+/// One client's input for one tick.
+struct InputLogControls
+{
+    unsigned clientId_;
+    unsigned buttons_;
+    float yaw_;
+};
+
+/// One record read back from an input log. Joins fill in the identity and spawn position, ticks the controls.
+struct InputLogRecord
+{
+    InputLogRecord()
+        : type_(INPUTREC_NONE)
+        , clientId_(0)
+        , colorIdx_(0)
+        , position_(Vector3::ZERO)
+    {
+    }
+
+    InputRecordType type_;
+    unsigned clientId_;
+    String userName_;
+    int colorIdx_;
+    Vector3 position_;
+    PODVector<InputLogControls> controls_;
+};
+
+//=============================================================================
+//=============================================================================
+/// Server: writes every client's controls per physics tick, plus joins and leaves, to a compact binary log that
+/// 76_Network_Replay runs offline. Client ids are assigned by the server and never reused within a log.
+///
+/// Layout: "NIRL", version, physics fps, then records. A record is a type byte followed by
+///   join:  VLE id, name, int color index, Vector3 spawn position
+///   leave: VLE id
+///   tick:  VLE count, then per client VLE id, VLE buttons, float yaw
+class InputLogWriter
+{
+public:
+    InputLogWriter();
+    ~InputLogWriter();
+
+    bool Open(Context* context, const String &fileName, int fps);
+    void Close();
+    bool IsOpen() const { return file_.NotNull(); }
+
+    void WriteJoin(unsigned clientId, const String &userName, int colorIdx, const Vector3 &position);
+    void WriteLeave(unsigned clientId);
+    /// Start a tick record, followed by exactly numClients WriteControls calls.
+    void BeginTick(unsigned numClients);
+    void WriteControls(unsigned clientId, const Controls &controls);
+
+    unsigned GetNumTicks() const { return numTicks_; }
+
+private:
+    SharedPtr<File> file_;
+    unsigned numTicks_;
+};
+
+/// Reads an input log back, one record at a time.
+class InputLogReader
+{
+public:
+    InputLogReader();
+    ~InputLogReader();
+
+    bool Open(Context* context, const String &fileName);
+    /// Read the next record, returns false at the end of the log or on a malformed record.
+    bool Read(InputLogRecord& record);
+
+    int GetFps() const { return fps_; }
+
+private:
+    SharedPtr<File> file_;
+    int fps_;
+};
@@ -0,0 +1,218 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <Urho3D/IO/Deserializer.h>
+#include <Urho3D/IO/Serializer.h>
+#include <Urho3D/Math/MathDefs.h>
+
+#include "InputPacket.h"
+
+#include <Urho3D/DebugNew.h>
+//=============================================================================
+//=============================================================================
+static const float YAW_RANGE = 65536.0f;
+static const unsigned char COUNT_MASK = 0x07;
+static const unsigned REPEAT_SHIFT = 3;
+
+unsigned short QuantizeYaw(float yaw)
+{
+    float wrapped = fmodf(yaw, 360.0f);
+    if (wrapped < 0.0f)
+    {
+        wrapped += 360.0f;
+    }
+    return (unsigned short)((unsigned)RoundToInt(wrapped * (YAW_RANGE / 360.0f)) & 0xffff);
+}
+
+float DequantizeYaw(unsigned short yaw)
+{
+    return yaw * (360.0f / YAW_RANGE);
+}
+
+//=============================================================================
+//=============================================================================
+InputSender::InputSender()
+    : latched_(0)
+    , held_(0)
+    , yaw_(0.0f)
+{
+}
+
+void InputSender::Sample(unsigned buttons, float yaw)
+{
+    latched_ |= buttons;
+    held_ = buttons;
+    yaw_ = yaw;
+}
+
+void InputSender::Write(unsigned seq, Serializer& dest)
+{
+    InputFrame frame;
+    frame.seq_ = seq;
+    frame.buttons_ = (unsigned char)((latched_ | held_) & 0xff);
+    frame.yaw_ = QuantizeYaw(yaw_);
+    latched_ = 0;
+
+    // redundant copies must be consecutive, the receiver numbers them back from the newest
+    if (!history_.Empty() && history_.Back().seq_ + 1 != seq)
+    {
+        history_.Clear();
+    }
+    history_.Push(frame);
+    if (history_.Size() > HISTORY_SIZE)
+    {
+        history_.Erase(0);
+    }
+
+    unsigned count = history_.Size();
+    unsigned char header = (unsigned char)(count - 1);
+    for (unsigned i = 1; i < count; ++i)
+    {
+        if (history_[count - 1 - i] == history_[count - i])
+        {
+            header |= (unsigned char)(1 << (REPEAT_SHIFT + i - 1));
+        }
+    }
+
+    dest.WriteVLE(seq);
+    dest.WriteUByte(header);
+    for (unsigned i = 0; i < count; ++i)
+    {
+        if (i > 0 && (header & (1 << (REPEAT_SHIFT + i - 1))))
+            continue;
+
+        const InputFrame& input = history_[count - 1 - i];
+        dest.WriteUByte(input.buttons_);
+        dest.WriteUShort(input.yaw_);
+    }
+}
+
+void InputSender::Reset()
+{
+    history_.Clear();
+    latched_ = 0;
+    held_ = 0;
+    yaw_ = 0.0f;
+}
+
+//=============================================================================
+//=============================================================================
+InputReceiver::InputReceiver()
+    : newestSeq_(0)
+{
+}
+
+bool InputReceiver::Read(Deserializer& source, InputStats& stats)
+{
+    unsigned seq = source.ReadVLE();
+    unsigned char header = source.ReadUByte();
+    unsigned count = (header & COUNT_MASK) + 1u;
+
+    if (seq < count)
+        return false;
+
+    InputFrame frames[COUNT_MASK + 1];
+    for (unsigned i = 0; i < count; ++i)
+    {
+        frames[i].seq_ = seq - i;
+
+        if (i > 0 && (header & (1 << (REPEAT_SHIFT + i - 1))))
+        {
+            frames[i].buttons_ = frames[i - 1].buttons_;
+            frames[i].yaw_ = frames[i - 1].yaw_;
+            continue;
+        }
+
+        if (source.IsEof())
+            return false;
+        frames[i].buttons_ = source.ReadUByte();
+        frames[i].yaw_ = source.ReadUShort();
+    }
+
+    // late or duplicated packet
+    if (seq <= newestSeq_)
+        return true;
+
+    // older than anything the message carries is gone for good
+    unsigned oldest = seq - count + 1;
+    if (newestSeq_ && oldest > newestSeq_ + 1)
+    {
+        stats.lost_ += oldest - newestSeq_ - 1;
+    }
+
+    // oldest first, skipping what an earlier message delivered. The first message only starts the stream, inputs from
+    // before the client object existed are stale
+    unsigned delivered = newestSeq_ ? newestSeq_ : seq - 1;
+    for (unsigned i = count; i-- > 0;)
+    {
+        if (frames[i].seq_ <= delivered)
+            continue;
+
+        buffered_.Push(frames[i]);
+        ++stats.received_;
+        if (i > 0)
+        {
+            ++stats.recovered_;
+        }
+    }
+    newestSeq_ = seq;
+
+    while (buffered_.Size() > MAX_BUFFERED)
+    {
+        buffered_[1].buttons_ |= buffered_[0].buttons_;
+        buffered_.Erase(0);
+    }
+
+    return true;
+}
+
+const InputFrame& InputReceiver::Next()
+{
+    if (!buffered_.Empty())
+    {
+        last_ = buffered_[0];
+        buffered_.Erase(0);
+    }
+    return last_;
+}
+
+const InputFrame& InputReceiver::NextMerged()
+{
+    if (!buffered_.Empty())
+    {
+        last_ = buffered_.Back();
+        for (unsigned i = 0; i + 1 < buffered_.Size(); ++i)
+        {
+            last_.buttons_ |= buffered_[i].buttons_;
+        }
+        buffered_.Clear();
+    }
+    return last_;
+}
+
+void InputReceiver::Reset()
+{
+    buffered_.Clear();
+    last_ = InputFrame();
+    newestSeq_ = 0;
+}
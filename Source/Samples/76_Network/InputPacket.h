@@ -0,0 +1,133 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include <Urho3D/Container/Vector.h>
+
+namespace Urho3D
+{
+class Deserializer;
+class Serializer;
+}
+
+using namespace Urho3D;
+//=============================================================================
+//=============================================================================
+/// Network message id of client input, custom ids must stay clear of the engine's own.
+static const int MSG_CLIENTINPUT = 33;
+
+/// One client input, sampled for one network update and numbered by it.
+struct InputFrame
+{
+    InputFrame()
+        : seq_(0)
+        , buttons_(0)
+        , yaw_(0)
+    {
+    }
+
+    bool operator ==(const InputFrame& rhs) const { return buttons_ == rhs.buttons_ && yaw_ == rhs.yaw_; }
+    bool operator !=(const InputFrame& rhs) const { return !(*this == rhs); }
+
+    unsigned seq_;
+    /// Low 8 button bits.
+    unsigned char buttons_;
+    /// Yaw wrapped to 0-360 degrees in 16 bits.
+    unsigned short yaw_;
+};
+
+/// Input delivery counters, totals over all clients.
+struct InputStats
+{
+    InputStats()
+        : received_(0)
+        , recovered_(0)
+        , lost_(0)
+    {
+    }
+
+    /// Inputs received, those that only arrived as a later message's redundant copy, and those that never arrived.
+    unsigned received_;
+    unsigned recovered_;
+    unsigned lost_;
+};
+
+unsigned short QuantizeYaw(float yaw);
+float DequantizeYaw(unsigned short yaw);
+
+//=============================================================================
+//=============================================================================
+/// Client: builds the input message sent with every network update. Each message carries the newest input and the
+/// HISTORY_SIZE - 1 before it, so an input survives that many lost packets in a row.
+///
+/// Layout: VLE seq of the newest input, a header byte (bits 0-2 input count - 1, bit 3 + i set when input i + 1 equals
+/// input i), then newest first, a button byte and a 16 bit yaw for each input not marked as a repeat. Steady input
+/// costs 6 bytes.
+class InputSender
+{
+public:
+    InputSender();
+
+    /// Sample one tick's controls. Buttons down at any tick since the last write are sent, so a tap shorter than the
+    /// send interval still goes out.
+    void Sample(unsigned buttons, float yaw);
+    /// Close the current input under seq, which follows the previous write's, and write the message.
+    void Write(unsigned seq, Serializer& dest);
+    void Reset();
+
+    static const unsigned HISTORY_SIZE = 4;
+
+private:
+    /// Sent inputs, oldest first.
+    PODVector<InputFrame> history_;
+    unsigned latched_;
+    unsigned held_;
+    float yaw_;
+};
+
+/// Server: one client's received inputs, applied one per tick in sequence order. Inputs seen before are dropped, and a
+/// tick with nothing new repeats the last input, which holds buttons down rather than pressing them again.
+class InputReceiver
+{
+public:
+    InputReceiver();
+
+    /// Decode a message and buffer the inputs not received before, returns false on a malformed message.
+    bool Read(Deserializer& source, InputStats& stats);
+    /// Return the input for the next tick.
+    const InputFrame& Next();
+    /// Return every buffered input folded into one, keeping buttons pressed in any of them, for a consumer that
+    /// samples less often than inputs arrive.
+    const InputFrame& NextMerged();
+    unsigned GetNumBuffered() const { return buffered_.Size(); }
+    void Reset();
+
+    /// Older inputs are folded into the next when a burst arrives, so a late client doesn't fall further behind.
+    static const unsigned MAX_BUFFERED = 4;
+
+private:
+    PODVector<InputFrame> buffered_;
+    InputFrame last_;
+    unsigned newestSeq_;
+};
@@ -0,0 +1,110 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <Urho3D/Math/MathDefs.h>
+
+#include "InterestGrid.h"
+
+#include <Urho3D/DebugNew.h>
+//=============================================================================
+//=============================================================================
+InterestGrid::InterestGrid()
+    : cellSize_(1.0f)
+    , numBuckets_(1)
+{
+}
+
+void InterestGrid::Build(const PODVector<Vector3>& positions, float cellSize)
+{
+    cellSize_ = Max(cellSize, M_EPSILON);
+    positions_ = positions;
+
+    // twice as many buckets as entries keeps collisions rare
+    numBuckets_ = NextPowerOfTwo(Max(positions_.Size() * 2, 64U));
+
+    bucketStart_.Resize(numBuckets_ + 1);
+    for (unsigned i = 0; i <= numBuckets_; ++i)
+    {
+        bucketStart_[i] = 0;
+    }
+
+    // count, prefix sum, then scatter
+    PODVector<unsigned> entryBuckets(positions_.Size());
+
+    for (unsigned i = 0; i < positions_.Size(); ++i)
+    {
+        entryBuckets[i] = GetBucket(GetCell(positions_[i].x_), GetCell(positions_[i].z_));
+        ++bucketStart_[entryBuckets[i] + 1];
+    }
+
+    for (unsigned i = 0; i < numBuckets_; ++i)
+    {
+        bucketStart_[i + 1] += bucketStart_[i];
+    }
+
+    entries_.Resize(positions_.Size());
+    PODVector<unsigned> fill(bucketStart_.Buffer(), numBuckets_);
+
+    for (unsigned i = 0; i < positions_.Size(); ++i)
+    {
+        entries_[fill[entryBuckets[i]]++] = i;
+    }
+}
+
+void InterestGrid::Query(const Vector3& center, float radius, PODVector<unsigned>& result) const
+{
+    if (positions_.Empty())
+        return;
+
+    const float radiusSquared = radius * radius;
+    const int minX = GetCell(center.x_ - radius);
+    const int maxX = GetCell(center.x_ + radius);
+    const int minZ = GetCell(center.z_ - radius);
+    const int maxZ = GetCell(center.z_ + radius);
+
+    // different cells can hash to the same bucket, visit each bucket once
+    visited_.Clear();
+
+    for (int z = minZ; z <= maxZ; ++z)
+    {
+        for (int x = minX; x <= maxX; ++x)
+        {
+            unsigned bucket = GetBucket(x, z);
+
+            if (visited_.Contains(bucket))
+                continue;
+            visited_.Push(bucket);
+
+            for (unsigned i = bucketStart_[bucket]; i < bucketStart_[bucket + 1]; ++i)
+            {
+                const Vector3& position = positions_[entries_[i]];
+                float dx = position.x_ - center.x_;
+                float dz = position.z_ - center.z_;
+
+                if (dx * dx + dz * dz <= radiusSquared)
+                {
+                    result.Push(entries_[i]);
+                }
+            }
+        }
+    }
+}
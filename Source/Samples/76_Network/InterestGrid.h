@@ -0,0 +1,61 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include <Urho3D/Container/Vector.h>
+#include <Urho3D/Math/Vector3.h>
+
+using namespace Urho3D;
+//=============================================================================
+//=============================================================================
+/// Spatial hash of points on the XZ plane. Rebuilt from scratch each update with a counting sort, so entries are stored
+/// contiguously per bucket and a radius query touches only the few buckets under it.
+class InterestGrid
+{
+public:
+    InterestGrid();
+
+    /// Rebuild from positions, an entry's index in the array is what queries return.
+    void Build(const PODVector<Vector3>& positions, float cellSize);
+    /// Append indices of all entries within radius of center on the XZ plane. Uses a scratch buffer of the grid, so
+    /// queries on one grid must not run concurrently.
+    void Query(const Vector3& center, float radius, PODVector<unsigned>& result) const;
+
+    unsigned GetNumEntries() const { return positions_.Size(); }
+
+private:
+    unsigned GetBucket(int x, int z) const
+    {
+        return (((unsigned)x * 73856093u) ^ ((unsigned)z * 19349663u)) & (numBuckets_ - 1);
+    }
+    int GetCell(float coord) const { return FloorToInt(coord / cellSize_); }
+
+    float cellSize_;
+    unsigned numBuckets_;
+    PODVector<Vector3> positions_;
+    /// Start of each bucket in entries_, numBuckets_ + 1 long.
+    PODVector<unsigned> bucketStart_;
+    PODVector<unsigned> entries_;
+    /// Buckets a query has visited, kept to avoid an allocation per query.
+    mutable PODVector<unsigned> visited_;
+};
@@ -0,0 +1,199 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <Urho3D/Container/Sort.h>
+#include <Urho3D/Math/Ray.h>
+#include <Urho3D/Math/Sphere.h>
+
+#include "LagCompensation.h"
+
+#include <Urho3D/DebugNew.h>
+//=============================================================================
+//=============================================================================
+static bool CompareLagEntity(const LagEntity& lhs, const LagEntity& rhs)
+{
+    return lhs.id_ < rhs.id_;
+}
+
+//=============================================================================
+//=============================================================================
+LagCompensation::LagCompensation()
+    : capacity_(0)
+    , maxEntities_(0)
+    , head_(0)
+    , numFrames_(0)
+{
+}
+
+void LagCompensation::SetCapacity(unsigned numFrames, unsigned maxEntities)
+{
+    capacity_ = maxEntities ? numFrames : 0;
+    maxEntities_ = maxEntities;
+    entries_.Resize(capacity_ * maxEntities_);
+    counts_.Resize(capacity_);
+    times_.Resize(capacity_);
+    rewound_.Reserve(maxEntities_);
+    Clear();
+}
+
+unsigned LagCompensation::GetMemoryUse() const
+{
+    return entries_.Capacity() * sizeof(LagEntity) + counts_.Capacity() * sizeof(unsigned) +
+        times_.Capacity() * sizeof(float) + rewound_.Capacity() * sizeof(LagEntity);
+}
+
+void LagCompensation::Clear()
+{
+    head_ = 0;
+    numFrames_ = 0;
+    rewound_.Clear();
+}
+
+void LagCompensation::BeginFrame(float time)
+{
+    if (!capacity_)
+        return;
+
+    times_[head_] = time;
+    counts_[head_] = 0;
+}
+
+void LagCompensation::AddEntity(unsigned id, const Vector3& position, float radius)
+{
+    if (!capacity_ || counts_[head_] >= maxEntities_)
+        return;
+
+    LagEntity& entity = entries_[head_ * maxEntities_ + counts_[head_]++];
+    entity.id_ = id;
+    entity.position_ = position;
+    entity.radius_ = radius;
+}
+
+void LagCompensation::EndFrame()
+{
+    if (!capacity_)
+        return;
+
+    // ids mostly arrive in order already, slot order only changes when a client leaves
+    PODVector<LagEntity>::Iterator start = entries_.Begin() + head_ * maxEntities_;
+    Sort(start, start + counts_[head_], CompareLagEntity);
+
+    head_ = (head_ + 1) % capacity_;
+    numFrames_ = Min(numFrames_ + 1, capacity_);
+}
+
+float LagCompensation::GetOldestTime() const
+{
+    return numFrames_ ? times_[GetFrameIndex(0)] : 0.0f;
+}
+
+float LagCompensation::GetNewestTime() const
+{
+    return numFrames_ ? times_[GetFrameIndex(numFrames_ - 1)] : 0.0f;
+}
+
+bool LagCompensation::Rewind(float time)
+{
+    rewound_.Clear();
+
+    if (!numFrames_)
+        return false;
+
+    // the newest frame at or before the time, the next one after it
+    unsigned older = 0;
+    for (unsigned i = numFrames_; i-- > 0;)
+    {
+        if (times_[GetFrameIndex(i)] <= time)
+        {
+            older = i;
+            break;
+        }
+    }
+    unsigned newer = Min(older + 1, numFrames_ - 1);
+
+    unsigned a = GetFrameIndex(older);
+    unsigned b = GetFrameIndex(newer);
+    float span = times_[b] - times_[a];
+    float t = span > 0.0f ? Clamp((time - times_[a]) / span, 0.0f, 1.0f) : 0.0f;
+
+    // objects in both frames are interpolated, one that spawned in between is taken as first seen, one that left in
+    // between is gone
+    const LagEntity* from = &entries_[a * maxEntities_];
+    const LagEntity* fromEnd = from + counts_[a];
+    const LagEntity* to = &entries_[b * maxEntities_];
+    const LagEntity* toEnd = to + counts_[b];
+
+    for (; to != toEnd; ++to)
+    {
+        while (from != fromEnd && from->id_ < to->id_)
+        {
+            ++from;
+        }
+
+        LagEntity entity = *to;
+        if (from != fromEnd && from->id_ == to->id_)
+        {
+            entity.position_ = from->position_.Lerp(to->position_, t);
+        }
+        rewound_.Push(entity);
+    }
+
+    return true;
+}
+
+bool LagCompensation::Raycast(const Ray& ray, float maxDistance, LagHit& hit, unsigned ignoreId) const
+{
+    hit.id_ = 0;
+    hit.distance_ = maxDistance;
+
+    for (unsigned i = 0; i < rewound_.Size(); ++i)
+    {
+        const LagEntity& entity = rewound_[i];
+        if (entity.id_ == ignoreId)
+            continue;
+
+        float distance = ray.HitDistance(Sphere(entity.position_, entity.radius_));
+        if (distance < hit.distance_)
+        {
+            hit.id_ = entity.id_;
+            hit.distance_ = distance;
+            hit.position_ = entity.position_;
+        }
+    }
+
+    return hit.id_ != 0;
+}
+
+void LagCompensation::SphereQuery(const Sphere& sphere, PODVector<unsigned>& result) const
+{
+    for (unsigned i = 0; i < rewound_.Size(); ++i)
+    {
+        const LagEntity& entity = rewound_[i];
+        float reach = sphere.radius_ + entity.radius_;
+
+        if ((entity.position_ - sphere.center_).LengthSquared() <= reach * reach)
+        {
+            result.Push(entity.id_);
+        }
+    }
+}
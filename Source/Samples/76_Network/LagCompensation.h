@@ -0,0 +1,113 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include <Urho3D/Container/Vector.h>
+#include <Urho3D/Math/Vector3.h>
+
+namespace Urho3D
+{
+class Ray;
+class Sphere;
+}
+
+using namespace Urho3D;
+//=============================================================================
+//=============================================================================
+/// One object's recorded state, a sphere is all a Baller needs for hit and proximity tests.
+struct LagEntity
+{
+    unsigned id_;
+    Vector3 position_;
+    float radius_;
+};
+
+/// Result of a lag compensated raycast.
+struct LagHit
+{
+    unsigned id_;
+    float distance_;
+    Vector3 position_;
+};
+
+//=============================================================================
+//=============================================================================
+/// Server: fixed capacity history of client object states, one frame per network update, for resolving hit and
+/// proximity tests against what a client saw rather than the newer present. Frames live in one contiguous ring of
+/// maxEntities slots each, indexed by frame number, so memory is fixed once the capacity is set.
+///
+/// Rewinding interpolates every object between the two frames around the requested time into a scratch copy which the
+/// queries test against, the live nodes and rigid bodies are never moved, so there is nothing to put back in the
+/// physics world afterwards.
+class LagCompensation
+{
+public:
+    LagCompensation();
+
+    /// Allocate numFrames frames of up to maxEntities objects, clearing the history.
+    void SetCapacity(unsigned numFrames, unsigned maxEntities);
+    unsigned GetCapacity() const { return capacity_; }
+    unsigned GetMaxEntities() const { return maxEntities_; }
+    /// Return the number of frames recorded, up to the capacity.
+    unsigned GetNumFrames() const { return numFrames_; }
+    /// Return bytes held by the history and the rewind buffer.
+    unsigned GetMemoryUse() const;
+    void Clear();
+
+    /// Start a frame at a server time in seconds, overwriting the oldest once the history is full. Times must increase.
+    void BeginFrame(float time);
+    /// Add an object to the current frame, objects past maxEntities are dropped.
+    void AddEntity(unsigned id, const Vector3& position, float radius);
+    /// Finish the current frame. Entries are sorted by id so two frames are matched in one pass.
+    void EndFrame();
+
+    float GetOldestTime() const;
+    float GetNewestTime() const;
+
+    /// Rewind to a server time, times outside the history clamp to its ends. Returns false when nothing is recorded.
+    bool Rewind(float time);
+    /// Return the rewound object states.
+    const PODVector<LagEntity>& GetRewound() const { return rewound_; }
+    /// Return the nearest rewound object hit by a ray within maxDistance, skipping ignoreId, e.g. the shooter's own.
+    bool Raycast(const Ray& ray, float maxDistance, LagHit& hit, unsigned ignoreId = 0) const;
+    /// Append ids of rewound objects overlapping a sphere.
+    void SphereQuery(const Sphere& sphere, PODVector<unsigned>& result) const;
+    /// Drop the rewound state, queries see nothing until the next rewind.
+    void Restore() { rewound_.Clear(); }
+
+private:
+    /// Ring index of the i-th frame, oldest first.
+    unsigned GetFrameIndex(unsigned i) const { return (head_ + capacity_ - numFrames_ + i) % capacity_; }
+
+    /// capacity_ * maxEntities_ entries, frame f starts at f * maxEntities_.
+    PODVector<LagEntity> entries_;
+    PODVector<unsigned> counts_;
+    PODVector<float> times_;
+    unsigned capacity_;
+    unsigned maxEntities_;
+    /// Ring index of the frame being or next to be written.
+    unsigned head_;
+    unsigned numFrames_;
+    PODVector<LagEntity> rewound_;
+};
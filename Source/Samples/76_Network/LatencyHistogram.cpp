@@ -0,0 +1,120 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <Urho3D/Math/MathDefs.h>
+
+#include "LatencyHistogram.h"
+
+#include <Urho3D/DebugNew.h>
+//=============================================================================
+//=============================================================================
+// 1us linear buckets up to 16us, then 16 per power of two, the last one holds everything above 2^32us (~70 min)
+const float LatencyHistogram::BUCKET_BASE_MS = 0.001f;
+
+//=============================================================================
+//=============================================================================
+LatencyHistogram::LatencyHistogram()
+{
+    Reset();
+}
+
+unsigned LatencyHistogram::GetBucket(float ms)
+{
+    float units = ms / BUCKET_BASE_MS;
+    if (units < (float)SUB_BUCKETS)
+        return units > 0.0f ? (unsigned)units : 0;
+
+    // units = mantissa * 2^exponent with the mantissa in [0.5, 1), its top bits below the leading one pick the sub bucket
+    int exponent;
+    float mantissa = frexpf(units, &exponent);
+    unsigned octave = (unsigned)exponent - (SUB_BUCKET_BITS + 1);
+    if (octave >= NUM_OCTAVES)
+        return NUM_BUCKETS - 1;
+
+    unsigned sub = Min((unsigned)((mantissa * 2.0f - 1.0f) * SUB_BUCKETS), SUB_BUCKETS - 1);
+    return SUB_BUCKETS + octave * SUB_BUCKETS + sub;
+}
+
+float LatencyHistogram::GetBucketUpperBound(unsigned index)
+{
+    if (index < SUB_BUCKETS)
+        return (index + 1) * BUCKET_BASE_MS;
+
+    unsigned octave = (index - SUB_BUCKETS) / SUB_BUCKETS;
+    unsigned sub = (index - SUB_BUCKETS) % SUB_BUCKETS;
+    return (SUB_BUCKETS + sub + 1) * (float)(1u << octave) * BUCKET_BASE_MS;
+}
+
+void LatencyHistogram::Record(float ms)
+{
+    ++buckets_[GetBucket(ms)];
+    ++count_;
+    sum_ += ms;
+    max_ = Max(max_, ms);
+}
+
+void LatencyHistogram::Merge(const LatencyHistogram& other)
+{
+    for (unsigned i = 0; i < NUM_BUCKETS; ++i)
+    {
+        buckets_[i] += other.buckets_[i];
+    }
+    count_ += other.count_;
+    sum_ += other.sum_;
+    max_ = Max(max_, other.max_);
+}
+
+void LatencyHistogram::Reset()
+{
+    for (unsigned i = 0; i < NUM_BUCKETS; ++i)
+    {
+        buckets_[i] = 0;
+    }
+    count_ = 0;
+    sum_ = 0.0;
+    max_ = 0.0f;
+}
+
+float LatencyHistogram::GetPercentile(float fraction) const
+{
+    if (!count_)
+        return 0.0f;
+
+    unsigned target = Max((unsigned)CeilToInt(Clamp(fraction, 0.0f, 1.0f) * count_), 1U);
+    unsigned seen = 0;
+
+    for (unsigned i = 0; i < NUM_BUCKETS - 1; ++i)
+    {
+        seen += buckets_[i];
+        if (seen >= target)
+            return Min(GetBucketUpperBound(i), max_);
+    }
+
+    return max_;
+}
+
+String LatencyHistogram::ToString() const
+{
+    return Urho3D::ToString("n=%u mean=%.3fms p50=%.3fms p90=%.3fms p99=%.3fms p99.9=%.3fms max=%.3fms",
+        count_, GetMean(), GetPercentile(0.5f), GetPercentile(0.9f), GetPercentile(0.99f), GetPercentile(0.999f), max_);
+}
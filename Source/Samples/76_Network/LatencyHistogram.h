@@ -0,0 +1,67 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include <Urho3D/Container/Str.h>
+
+using namespace Urho3D;
+//=============================================================================
+//=============================================================================
+/// Fixed size latency histogram in milliseconds, laid out like an HDR histogram. The first SUB_BUCKETS buckets are
+/// BUCKET_BASE_MS wide, and every power of two above them is split into SUB_BUCKETS equal buckets. Recording is a
+/// frexp and an increment, and percentiles are good to 1 / SUB_BUCKETS (6%) from microseconds to over half an hour.
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+
+    void Record(float ms);
+    /// Add another histogram's samples to this one.
+    void Merge(const LatencyHistogram& other);
+    void Reset();
+
+    unsigned GetCount() const { return count_; }
+    float GetMean() const { return count_ ? (float)(sum_ / count_) : 0.0f; }
+    float GetMax() const { return max_; }
+    /// Return the upper bound of the bucket holding the given fraction (0-1) of the samples, capped at the max.
+    float GetPercentile(float fraction) const;
+    /// One line summary: count, mean, p50, p90, p99, p99.9 and max.
+    String ToString() const;
+
+    static const unsigned SUB_BUCKET_BITS = 4;
+    static const unsigned SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static const unsigned NUM_OCTAVES = 28;
+    /// Linear buckets, the octaves, and one for everything above.
+    static const unsigned NUM_BUCKETS = SUB_BUCKETS * (NUM_OCTAVES + 1) + 1;
+    static const float BUCKET_BASE_MS;
+
+private:
+    static unsigned GetBucket(float ms);
+    static float GetBucketUpperBound(unsigned index);
+
+    unsigned buckets_[NUM_BUCKETS];
+    unsigned count_;
+    double sum_;
+    float max_;
+};
@@ -0,0 +1,52 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <Urho3D/Graphics/Material.h>
+#include <Urho3D/Resource/ResourceCache.h>
+
+#include "MaterialPalette.h"
+#include "Baller.h"
+
+#include <Urho3D/DebugNew.h>
+//=============================================================================
+//=============================================================================
+MaterialPalette::MaterialPalette(Context* context)
+    : Object(context)
+{
+}
+
+MaterialPalette::~MaterialPalette()
+{
+}
+
+void MaterialPalette::Load()
+{
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
+
+    materials_.Resize(MAX_MAT_COUNT);
+    for (int i = 0; i < MAX_MAT_COUNT; ++i)
+    {
+        materials_[i] = cache->GetResource<Material>(ToString("NetDemo/ballmat%i.xml", i));
+    }
+
+    adminMaterial_ = cache->GetResource<Material>(ToString("NetDemo/ballmat%i.xml", ADMIN_COLOR_INDEX));
+}
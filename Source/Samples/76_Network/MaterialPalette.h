@@ -0,0 +1,59 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include <Urho3D/Core/Object.h>
+
+namespace Urho3D
+{
+class Material;
+}
+
+using namespace Urho3D;
+//=============================================================================
+//=============================================================================
+/// Ball materials resolved once into an indexed table, so a colour index maps to its material with a plain array
+/// index instead of a formatted name and a resource cache lookup.
+class MaterialPalette : public Object
+{
+    URHO3D_OBJECT(MaterialPalette, Object);
+
+public:
+    MaterialPalette(Context* context);
+    virtual ~MaterialPalette();
+
+    /// Resolve every ballmat%i.xml and the admin ballmat99.xml.
+    void Load();
+
+    /// Return the material for a colour index, indices outside the palette get the admin material.
+    Material* GetMaterial(int colorIdx) const
+    {
+        return (unsigned)colorIdx < materials_.Size() ? materials_[colorIdx] : adminMaterial_;
+    }
+
+    static const int ADMIN_COLOR_INDEX = 99;
+
+protected:
+    Vector<SharedPtr<Material> > materials_;
+    SharedPtr<Material> adminMaterial_;
+};
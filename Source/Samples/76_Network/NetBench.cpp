@@ -0,0 +1,759 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/ProcessUtils.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Engine/Engine.h>
+#include <Urho3D/Graphics/Model.h>
+#include <Urho3D/Input/Controls.h>
+#include <Urho3D/IO/FileSystem.h>
+#include <Urho3D/IO/VectorBuffer.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/Math/Ray.h>
+#include <Urho3D/Math/Sphere.h>
+#include <Urho3D/Physics/PhysicsEvents.h>
+#include <Urho3D/Physics/CollisionShape.h>
+#include <Urho3D/Physics/PhysicsWorld.h>
+#include <Urho3D/Physics/RigidBody.h>
+#include <Urho3D/Resource/ResourceCache.h>
+#include <Urho3D/Scene/Scene.h>
+
+#include "NetBench.h"
+#include "ClientObj.h"
+#include "Baller.h"
+#include "BallerSystem.h"
+#include "MaterialPalette.h"
+#include "CollisionMeshCache.h"
+#include "InterestGrid.h"
+#include "TransformCodec.h"
+#include "LagCompensation.h"
+#include "RoomSimulation.h"
+#include "SimulationThread.h"
+
+#include <Urho3D/DebugNew.h>
+//=============================================================================
+//=============================================================================
+URHO3D_DEFINE_APPLICATION_MAIN(NetBench)
+
+// kNet frames each message with its id and length, a byte each at these sizes
+static const unsigned MESSAGE_HEADER_BYTES = 2;
+
+/// Write what Connection sends for an object's network attributes that changed since the last call, and return the
+/// bytes. Latest data attributes go all together in one message, the rest as a dirty bitmask and the changed values.
+static unsigned WriteNetworkUpdate(Serializable* object, unsigned id, Vector<Variant>& lastValues, VectorBuffer& dest)
+{
+    const Vector<AttributeInfo>* attributes = object->GetNetworkAttributes();
+    if (!attributes)
+        return 0;
+
+    unsigned numAttributes = attributes->Size();
+    Vector<Variant> values(numAttributes);
+    lastValues.Resize(numAttributes);
+
+    bool latestDataDirty = false;
+    bool deltaDirty = false;
+    for (unsigned i = 0; i < numAttributes; ++i)
+    {
+        object->OnGetAttribute(attributes->At(i), values[i]);
+        if (values[i] != lastValues[i])
+        {
+            if (attributes->At(i).mode_ & AM_LATESTDATA)
+                latestDataDirty = true;
+            else
+                deltaDirty = true;
+        }
+    }
+
+    unsigned bytes = 0;
+
+    if (latestDataDirty)
+    {
+        dest.Clear();
+        dest.WriteNetID(id);
+        for (unsigned i = 0; i < numAttributes; ++i)
+        {
+            if (attributes->At(i).mode_ & AM_LATESTDATA)
+                dest.WriteVariantData(values[i]);
+        }
+        bytes += MESSAGE_HEADER_BYTES + dest.GetSize();
+    }
+
+    if (deltaDirty)
+    {
+        dest.Clear();
+        dest.WriteNetID(id);
+        for (unsigned i = 0; i < numAttributes; i += 8)
+        {
+            dest.WriteUByte(0);
+        }
+        for (unsigned i = 0; i < numAttributes; ++i)
+        {
+            if (!(attributes->At(i).mode_ & AM_LATESTDATA) && values[i] != lastValues[i])
+                dest.WriteVariantData(values[i]);
+        }
+        bytes += MESSAGE_HEADER_BYTES + dest.GetSize();
+    }
+
+    lastValues = values;
+    return bytes;
+}
+
+NetBench::NetBench(Context* context)
+    : Application(context)
+    , ticks_(300)
+{
+}
+
+void NetBench::Setup()
+{
+    ParseArguments();
+
+    engineParameters_["LogName"]       = GetSubsystem<FileSystem>()->GetProgramDir() + "netbench.log";
+    engineParameters_["Headless"]      = true;
+    engineParameters_["Sound"]         = false;
+    engineParameters_["ResourcePaths"] = "Data;CoreData;Data/NetDemo;";
+}
+
+void NetBench::Start()
+{
+    SetRandomSeed(1);
+
+    RegisterObjects();
+
+    if (IsSuiteEnabled("baller"))
+    {
+        BenchBallerMovement();
+    }
+
+    if (IsSuiteEnabled("interest"))
+    {
+        BenchInterest();
+    }
+
+    if (IsSuiteEnabled("codec"))
+    {
+        BenchTransformCodec();
+    }
+
+    if (IsSuiteEnabled("collision"))
+    {
+        BenchCollisionMesh();
+    }
+
+    if (IsSuiteEnabled("rooms"))
+    {
+        BenchRooms();
+    }
+
+    if (IsSuiteEnabled("lagcomp"))
+    {
+        BenchLagCompensation();
+    }
+
+    if (IsSuiteEnabled("dormancy"))
+    {
+        BenchDormancy();
+    }
+
+    engine_->Exit();
+}
+
+void NetBench::ParseArguments()
+{
+    const Vector<String>& arguments = GetArguments();
+
+    for (unsigned i = 0; i + 1 < arguments.Size(); ++i)
+    {
+        String argument = arguments[i].ToLower();
+        const String& value = arguments[i + 1];
+
+        if (argument == "-suite")
+        {
+            suite_ = value.ToLower();
+            ++i;
+        }
+        else if (argument == "-ticks")
+        {
+            ticks_ = Max(ToUInt(value), 1U);
+            ++i;
+        }
+    }
+}
+
+void NetBench::RegisterObjects()
+{
+    MaterialPalette* palette = new MaterialPalette(context_);
+    context_->RegisterSubsystem(palette);
+    palette->Load();
+
+    ClientObj::RegisterObject(context_);
+    Baller::RegisterObject(context_);
+    BallerSystem::RegisterObject(context_);
+}
+
+bool NetBench::IsSuiteEnabled(const String &suite) const
+{
+    return suite_.Empty() || suite_ == suite;
+}
+
+void NetBench::Report(const String &suite, const String &name, float value, const String &unit)
+{
+    String line = ToString("%s.%s = %.3f %s", suite.CString(), name.CString(), value, unit.CString());
+    PrintLine(line);
+    URHO3D_LOGINFO(line);
+}
+
+SharedPtr<Scene> NetBench::CreateBallerScene(unsigned count, bool useSystem)
+{
+    SharedPtr<Scene> scene(new Scene(context_));
+    scene->CreateComponent<PhysicsWorld>(LOCAL);
+
+    if (useSystem)
+    {
+        scene->CreateComponent<BallerSystem>(LOCAL);
+    }
+
+    for (unsigned i = 0; i < count; ++i)
+    {
+        Node* clientNode = scene->CreateChild("client");
+        clientNode->SetPosition(Vector3(Random(200.0f) - 100.0f, 5.0f, Random(200.0f) - 100.0f));
+
+        Baller* baller = clientNode->CreateComponent<Baller>();
+        baller->SetClientInfo("bench", i % MAX_MAT_COUNT);
+    }
+
+    // one scene update runs each baller's DelayedStart
+    scene->Update(0.0f);
+
+    return scene;
+}
+
+void NetBench::BenchBallerMovement()
+{
+    static const unsigned counts[] = { 100, 1000, 10000 };
+    static const char* modeNames[] = { "component", "system" };
+
+    for (unsigned c = 0; c < 3; ++c)
+    {
+        for (unsigned mode = 0; mode < 2; ++mode)
+        {
+            SharedPtr<Scene> scene = CreateBallerScene(counts[c], mode == 1);
+            PhysicsWorld* physicsWorld = scene->GetComponent<PhysicsWorld>();
+
+            PODVector<Baller*> ballers;
+            scene->GetComponents<Baller>(ballers, true);
+
+            // movement keys only, material swaps would measure resource lookups instead
+            Vector<Controls> controls(ballers.Size());
+            for (unsigned i = 0; i < controls.Size(); ++i)
+            {
+                controls[i].buttons_ = (unsigned)Random(16);
+                controls[i].yaw_ = Random(360.0f);
+            }
+
+            using namespace PhysicsPreStep;
+            VariantMap eventData;
+            eventData[P_WORLD] = physicsWorld;
+            eventData[P_TIMESTEP] = 1.0f / 60.0f;
+
+            HiresTimer timer;
+            long long elapsed = 0;
+
+            for (unsigned t = 0; t < ticks_; ++t)
+            {
+                for (unsigned i = 0; i < ballers.Size(); ++i)
+                {
+                    ballers[i]->SetControls(controls[i]);
+                }
+
+                // time only the pre-step dispatch, which is where the two paths differ
+                timer.Reset();
+                physicsWorld->SendEvent(E_PHYSICSPRESTEP, eventData);
+                elapsed += timer.GetUSec(false);
+            }
+
+            Report("baller", ToString("%s.%u", modeNames[mode], counts[c]), (float)elapsed / (float)ticks_, "us/tick");
+        }
+    }
+}
+
+void NetBench::BenchInterest()
+{
+    // one player per 10x10m, seen within 30m. Times the grid and counts relevant nodes only, the bandwidth this saves
+    // is measured over real connections by 76_Network_ReplTest -interest -density
+    const float AREA_PER_PLAYER = 100.0f;
+    const float INTEREST_RADIUS = 30.0f;
+    static const unsigned counts[] = { 100, 1000, 10000 };
+
+    for (unsigned c = 0; c < 3; ++c)
+    {
+        unsigned count = counts[c];
+        float halfSize = Sqrt(count * AREA_PER_PLAYER) * 0.5f;
+
+        PODVector<Vector3> positions(count);
+        for (unsigned i = 0; i < count; ++i)
+        {
+            positions[i] = Vector3(Random(-halfSize, halfSize), 0.0f, Random(-halfSize, halfSize));
+        }
+
+        InterestGrid grid;
+        PODVector<unsigned> relevant;
+        unsigned long long relevantSum = 0;
+
+        HiresTimer timer;
+        long long elapsed = 0;
+
+        for (unsigned t = 0; t < ticks_; ++t)
+        {
+            timer.Reset();
+            grid.Build(positions, INTEREST_RADIUS);
+
+            for (unsigned i = 0; i < count; ++i)
+            {
+                relevant.Clear();
+                grid.Query(positions[i], INTEREST_RADIUS, relevant);
+                relevantSum += relevant.Size();
+            }
+            elapsed += timer.GetUSec(false);
+        }
+
+        float avgRelevant = (float)relevantSum / (float)(count * ticks_);
+
+        Report("interest", ToString("relevant.%u", count), avgRelevant, "nodes/client");
+        Report("interest", ToString("update.%u", count), (float)elapsed / (float)ticks_, "us/update");
+    }
+}
+
+void NetBench::BenchTransformCodec()
+{
+    const float TIME_STEP = 1.0f / 30.0f;
+    const float RADIUS = 20.0f;
+    const float SPEED = 0.5f;
+
+    TransformCodec codec;
+    TransformStreamWriter writer;
+    TransformStreamReader reader;
+    VectorBuffer buffer;
+
+    // engine path: the same states applied to a client object, whose node and components replicate by attribute
+    SharedPtr<Scene> scene = CreateBallerScene(1, false);
+    Node* clientNode = scene->GetChild("client");
+    Baller* baller = clientNode->GetComponent<Baller>();
+    const Vector<SharedPtr<Component> >& components = clientNode->GetComponents();
+    Vector<Vector<Variant> > lastValues(components.Size() + 1);
+
+    // everything is dirty once, as when the object is created, that isn't an update
+    WriteNetworkUpdate(clientNode, clientNode->GetID(), lastValues[0], buffer);
+    for (unsigned i = 0; i < components.Size(); ++i)
+    {
+        WriteNetworkUpdate(components[i], components[i]->GetID(), lastValues[i + 1], buffer);
+    }
+
+    unsigned long long movingBytes = 0;
+    unsigned long long restBytes = 0;
+    unsigned long long movingAttributeBytes = 0;
+    unsigned long long restAttributeBytes = 0;
+    float maxPositionError = 0.0f;
+    float maxRotationError = 0.0f;
+
+    // half the ticks rolling around a circle, half at rest
+    for (unsigned t = 0; t < ticks_ * 2; ++t)
+    {
+        bool moving = t < ticks_;
+        float angle = (moving ? t : ticks_) * TIME_STEP * SPEED * M_RADTODEG;
+
+        TransformState state;
+        state.position_ = Vector3(Cos(angle) * RADIUS, 0.5f, Sin(angle) * RADIUS);
+        state.rotation_ = Quaternion(angle * 7.0f, Vector3(-Sin(angle), 0.0f, Cos(angle)));
+
+        if (moving)
+        {
+            state.linearVelocity_ = Vector3(-Sin(angle), 0.0f, Cos(angle)) * (RADIUS * SPEED);
+            state.angularVelocity_ = Vector3(-Sin(angle), 0.0f, Cos(angle)) * (RADIUS * SPEED * 2.0f);
+        }
+
+        baller->ApplyTransformState(state);
+        unsigned attributeBytes = WriteNetworkUpdate(clientNode, clientNode->GetID(), lastValues[0], buffer);
+        for (unsigned i = 0; i < components.Size(); ++i)
+        {
+            attributeBytes += WriteNetworkUpdate(components[i], components[i]->GetID(), lastValues[i + 1], buffer);
+        }
+        (moving ? movingAttributeBytes : restAttributeBytes) += attributeBytes;
+
+        QuantizedTransform quantized = codec.Quantize(state);
+        if (!writer.Write(codec, quantized, t * TIME_STEP, buffer))
+            continue;
+
+        (moving ? movingBytes : restBytes) += buffer.GetSize();
+
+        buffer.Seek(0);
+        QuantizedTransform received;
+        if (reader.Read(codec, buffer, received))
+        {
+            TransformState decoded = codec.Dequantize(received);
+            maxPositionError = Max(maxPositionError, (decoded.position_ - state.position_).Length());
+            maxRotationError = Max(maxRotationError, Abs(Acos(Clamp(Abs(decoded.rotation_.DotProduct(state.rotation_)), 0.0f, 1.0f)) * 2.0f));
+        }
+    }
+
+    Report("codec", "bytes_moving", (float)movingBytes / (float)ticks_, "B/update");
+    Report("codec", "bytes_rest", (float)restBytes / (float)ticks_, "B/update");
+    Report("codec", "bytes_attributes_moving", (float)movingAttributeBytes / (float)ticks_, "B/update");
+    Report("codec", "bytes_attributes_rest", (float)restAttributeBytes / (float)ticks_, "B/update");
+    Report("codec", "error_position", maxPositionError, "m");
+    Report("codec", "error_rotation", maxRotationError, "deg");
+
+    // a late joiner starts from the last written value alone, which must decode while the object is at rest
+    TransformStreamReader lateReader;
+    QuantizedTransform lateReceived;
+    buffer.Seek(0);
+    bool lateDecoded = lateReader.Read(codec, buffer, lateReceived) && lateReceived == writer.GetLastSent();
+    Report("codec", "late_join_decoded", lateDecoded ? 1.0f : 0.0f, "bool");
+    if (!lateDecoded)
+        URHO3D_LOGERROR("Codec: a late joiner can't decode an object at rest");
+}
+
+void NetBench::BenchCollisionMesh()
+{
+    const unsigned NUM_SCENES = 5;
+    static const char* modeNames[] = { "cold", "warm" };
+
+    Model* model = GetSubsystem<ResourceCache>()->GetResource<Model>("NetDemo/level1.mdl");
+    if (!model)
+        return;
+
+    SharedPtr<CollisionMeshCache> meshCache(new CollisionMeshCache(context_));
+
+    for (unsigned mode = 0; mode < 2; ++mode)
+    {
+        // warm: cook once up front, like the first scene of a run
+        if (mode == 1)
+        {
+            SharedPtr<Scene> scene(new Scene(context_));
+            scene->CreateComponent<PhysicsWorld>(LOCAL);
+            Node* floorNode = scene->CreateChild("floor", LOCAL);
+            floorNode->CreateComponent<RigidBody>();
+            meshCache->SetTriangleMesh(floorNode->CreateComponent<CollisionShape>(), model);
+        }
+
+        HiresTimer timer;
+        long long elapsed = 0;
+
+        // a new scene and physics world each time, like the sample rebuilding its scene on disconnect
+        for (unsigned i = 0; i < NUM_SCENES; ++i)
+        {
+            SharedPtr<Scene> scene(new Scene(context_));
+            scene->CreateComponent<PhysicsWorld>(LOCAL);
+            Node* floorNode = scene->CreateChild("floor", LOCAL);
+            floorNode->CreateComponent<RigidBody>();
+            CollisionShape* shape = floorNode->CreateComponent<CollisionShape>();
+
+            timer.Reset();
+            if (mode == 1)
+            {
+                meshCache->SetTriangleMesh(shape, model);
+            }
+            else
+            {
+                shape->SetTriangleMesh(model);
+            }
+            elapsed += timer.GetUSec(false);
+        }
+
+        Report("collision", modeNames[mode], (float)elapsed / (float)NUM_SCENES / 1000.0f, "ms/scene");
+    }
+}
+
+void NetBench::BenchRooms()
+{
+    const unsigned BALLERS_PER_ROOM = 16;
+    const unsigned MAX_ROOMS = 1024;
+    const int FPS = 60;
+    const float PERIOD_MS = 1000.0f / FPS;
+
+    Model* model = GetSubsystem<ResourceCache>()->GetResource<Model>("NetDemo/level1.mdl");
+    if (!model)
+        return;
+
+    // the level every room copies, and stand-ins for the replicated client objects the simulations key their ballers by
+    SharedPtr<CollisionMeshCache> meshCache(new CollisionMeshCache(context_));
+    SharedPtr<Scene> level(new Scene(context_));
+    level->CreateComponent<PhysicsWorld>(LOCAL)->SetFps(FPS);
+    Node* floorNode = level->CreateChild("floor", LOCAL);
+    floorNode->CreateComponent<RigidBody>();
+    meshCache->SetTriangleMesh(floorNode->CreateComponent<CollisionShape>(), model);
+
+    PODVector<Node*> clientNodes;
+    for (unsigned i = 0; i < BALLERS_PER_ROOM; ++i)
+    {
+        Node* clientNode = level->CreateChild("client");
+        clientNode->SetPosition(Vector3(Random(40.0f) - 20.0f, 5.0f, Random(40.0f) - 20.0f));
+        clientNodes.Push(clientNode);
+    }
+
+    unsigned numThreads = Max(GetNumPhysicalCPUs(), 2U) - 1;
+    unsigned maxRooms = 0;
+
+    // double the rooms until a thread's tick no longer fits in the period
+    for (unsigned numRooms = numThreads; numRooms <= MAX_ROOMS; numRooms *= 2)
+    {
+        Vector<SharedPtr<RoomSimulation> > rooms;
+        Vector<SimulationThread*> threads;
+
+        for (unsigned i = 0; i < numThreads; ++i)
+        {
+            threads.Push(new SimulationThread(FPS));
+        }
+
+        for (unsigned r = 0; r < numRooms; ++r)
+        {
+            SharedPtr<RoomSimulation> room(new RoomSimulation(context_));
+            room->CreateScene(level, FPS);
+            for (unsigned i = 0; i < clientNodes.Size(); ++i)
+            {
+                room->AddClient(clientNodes[i], "bench", i % MAX_MAT_COUNT, 0.0f);
+            }
+            rooms.Push(room);
+            threads[r % numThreads]->AddRoom(room);
+        }
+
+        for (unsigned i = 0; i < threads.Size(); ++i)
+        {
+            threads[i]->Run();
+        }
+
+        // feed movement input at the tick rate for ticks_ ticks, as the main thread would
+        for (unsigned t = 0; t < ticks_; ++t)
+        {
+            for (unsigned r = 0; r < rooms.Size(); ++r)
+            {
+                for (unsigned i = 0; i < clientNodes.Size(); ++i)
+                {
+                    SimInput input;
+                    input.nodeId_ = clientNodes[i]->GetID();
+                    input.buttons_ = (unsigned)Random(16);
+                    input.yaw_ = Random(360.0f);
+                    input.seq_ = 0;
+                    rooms[r]->PushInput(input);
+                }
+                rooms[r]->AcquireSnapshot();
+            }
+            Time::Sleep((unsigned)PERIOD_MS);
+        }
+
+        LatencyHistogram tickTime;
+        LatencyHistogram tickJitter;
+        for (unsigned i = 0; i < threads.Size(); ++i)
+        {
+            threads[i]->Stop();
+            tickTime.Merge(threads[i]->GetTickTime());
+            tickJitter.Merge(threads[i]->GetTickJitter());
+            delete threads[i];
+        }
+
+        LatencyHistogram roomTime;
+        for (unsigned r = 0; r < rooms.Size(); ++r)
+        {
+            roomTime.Merge(rooms[r]->GetTickTime());
+        }
+
+        Report("rooms", ToString("room_tick.%u", numRooms), roomTime.GetMean(), "ms");
+        Report("rooms", ToString("thread_tick_p99.%u", numRooms), tickTime.GetPercentile(0.99f), "ms");
+        Report("rooms", ToString("jitter_p99.%u", numRooms), tickJitter.GetPercentile(0.99f), "ms");
+
+        if (tickTime.GetPercentile(0.99f) > PERIOD_MS)
+            break;
+
+        maxRooms = numRooms;
+    }
+
+    Report("rooms", "threads", (float)numThreads, "threads");
+    Report("rooms", ToString("max.%u_ballers", BALLERS_PER_ROOM), (float)maxRooms, "rooms");
+}
+
+void NetBench::BenchLagCompensation()
+{
+    // a second of history at 30 updates/sec, one player per 10x10m moving at walking pace, shots resolved 150-183ms
+    // in the past
+    const unsigned NUM_FRAMES = 31;
+    const float UPDATE_TIME = 1.0f / 30.0f;
+    const float REWIND_TIME = 0.15f;
+    const float AREA_PER_PLAYER = 100.0f;
+    const float SPEED = 5.0f;
+    const float SHOT_RANGE = 100.0f;
+    const float OVERLAP_RADIUS = 5.0f;
+    static const unsigned counts[] = { 100, 1000 };
+
+    for (unsigned c = 0; c < 2; ++c)
+    {
+        unsigned count = counts[c];
+        float halfSize = Sqrt(count * AREA_PER_PLAYER) * 0.5f;
+
+        PODVector<Vector3> positions(count);
+        PODVector<Vector3> velocities(count);
+        for (unsigned i = 0; i < count; ++i)
+        {
+            float heading = Random(360.0f);
+            positions[i] = Vector3(Random(-halfSize, halfSize), 0.0f, Random(-halfSize, halfSize));
+            velocities[i] = Vector3(Cos(heading), 0.0f, Sin(heading)) * SPEED;
+        }
+
+        LagCompensation history;
+        history.SetCapacity(NUM_FRAMES, count);
+
+        HiresTimer timer;
+        long long recordUSec = 0;
+
+        for (unsigned f = 0; f < NUM_FRAMES; ++f)
+        {
+            timer.Reset();
+            history.BeginFrame(f * UPDATE_TIME);
+            for (unsigned i = 0; i < count; ++i)
+            {
+                history.AddEntity(i + 1, positions[i], 0.5f);
+            }
+            history.EndFrame();
+            recordUSec += timer.GetUSec(false);
+
+            for (unsigned i = 0; i < count; ++i)
+            {
+                positions[i] += velocities[i] * UPDATE_TIME;
+            }
+        }
+
+        const float now = (NUM_FRAMES - 1) * UPDATE_TIME;
+        long long rewindUSec = 0;
+        long long raycastUSec = 0;
+        long long sphereUSec = 0;
+        unsigned numHits = 0;
+        unsigned long long numOverlaps = 0;
+        PODVector<unsigned> overlapping;
+
+        for (unsigned t = 0; t < ticks_; ++t)
+        {
+            unsigned shooter = (unsigned)Random((int)count);
+            float heading = Random(360.0f);
+
+            timer.Reset();
+            history.Rewind(now - REWIND_TIME - Random(UPDATE_TIME));
+            rewindUSec += timer.GetUSec(false);
+
+            const Vector3 origin = history.GetRewound()[shooter].position_;
+
+            timer.Reset();
+            LagHit hit;
+            if (history.Raycast(Ray(origin, Vector3(Cos(heading), 0.0f, Sin(heading))), SHOT_RANGE, hit, shooter + 1))
+            {
+                ++numHits;
+            }
+            raycastUSec += timer.GetUSec(false);
+
+            timer.Reset();
+            overlapping.Clear();
+            history.SphereQuery(Sphere(origin, OVERLAP_RADIUS), overlapping);
+            numOverlaps += overlapping.Size();
+            sphereUSec += timer.GetUSec(false);
+
+            history.Restore();
+        }
+
+        Report("lagcomp", ToString("record.%u", count), (float)recordUSec / (float)NUM_FRAMES, "us/update");
+        Report("lagcomp", ToString("rewind.%u", count), (float)rewindUSec / (float)ticks_, "us/query");
+        Report("lagcomp", ToString("raycast.%u", count), (float)raycastUSec / (float)ticks_, "us/query");
+        Report("lagcomp", ToString("sphere.%u", count), (float)sphereUSec / (float)ticks_, "us/query");
+        Report("lagcomp", ToString("total.%u", count), (float)(rewindUSec + raycastUSec + sphereUSec) / (float)ticks_,
+            "us/query");
+        Report("lagcomp", ToString("hit_rate.%u", count), (float)numHits / (float)ticks_, "hits/shot");
+        Report("lagcomp", ToString("overlaps.%u", count), (float)numOverlaps / (float)ticks_, "objects/query");
+        Report("lagcomp", ToString("memory.%u", count), history.GetMemoryUse() / 1024.0f, "KB");
+    }
+}
+
+void NetBench::BenchDormancy()
+{
+    const unsigned COUNT = 1000;
+    const float IDLE_FRACTION = 0.8f;
+    const float DORMANCY_TIME = 1.0f;
+    const float TIME_STEP = 1.0f / 60.0f;
+    // long enough for dropped balls to settle and the idle ones to fall asleep
+    const unsigned SETTLE_TICKS = 300;
+    static const char* modeNames[] = { "off", "on" };
+
+    for (unsigned mode = 0; mode < 2; ++mode)
+    {
+        SetRandomSeed(1);
+        SharedPtr<Scene> scene = CreateBallerScene(COUNT, true);
+        PhysicsWorld* physicsWorld = scene->GetComponent<PhysicsWorld>();
+
+        Node* floorNode = scene->CreateChild("floor", LOCAL);
+        floorNode->SetPosition(Vector3(0.0f, -0.5f, 0.0f));
+        floorNode->CreateComponent<RigidBody>();
+        floorNode->CreateComponent<CollisionShape>()->SetBox(Vector3(400.0f, 1.0f, 400.0f));
+
+        PODVector<Baller*> ballers;
+        scene->GetComponents<Baller>(ballers, true);
+
+        // the first 80% are AFK, the rest hold random movement keys
+        unsigned numIdle = (unsigned)(COUNT * IDLE_FRACTION);
+        Vector<Controls> controls(ballers.Size());
+        for (unsigned i = numIdle; i < controls.Size(); ++i)
+        {
+            controls[i].buttons_ = (unsigned)Random(15) + 1;
+            controls[i].yaw_ = Random(360.0f);
+        }
+
+        for (unsigned i = 0; i < ballers.Size(); ++i)
+        {
+            ballers[i]->SetDormancyTime(mode == 1 ? DORMANCY_TIME : 0.0f);
+        }
+
+        HiresTimer timer;
+
+        for (unsigned t = 0; t < SETTLE_TICKS + ticks_; ++t)
+        {
+            if (t == SETTLE_TICKS)
+            {
+                timer.Reset();
+            }
+
+            for (unsigned i = 0; i < ballers.Size(); ++i)
+            {
+                ballers[i]->SetControls(controls[i]);
+            }
+
+            // the whole tick this time, dormancy saves in Bullet as much as in the movement pass
+            physicsWorld->Update(TIME_STEP);
+        }
+        long long elapsed = timer.GetUSec(false);
+
+        unsigned numDormant = 0;
+        for (unsigned i = 0; i < ballers.Size(); ++i)
+        {
+            if (ballers[i]->IsDormant())
+                ++numDormant;
+        }
+
+        Report("dormancy", ToString("%s.%u", modeNames[mode], COUNT), (float)elapsed / (float)ticks_, "us/tick");
+        Report("dormancy", ToString("%s.dormant", modeNames[mode]), (float)numDormant, "ballers");
+    }
+}
@@ -0,0 +1,74 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include <Urho3D/Engine/Application.h>
+
+namespace Urho3D
+{
+class Scene;
+}
+
+using namespace Urho3D;
+//=============================================================================
+//=============================================================================
+/// Headless offline benchmarks of the sample's server-side systems.
+/// usage: 76_Network_Bench [-suite <name>] [-ticks <n>]
+class NetBench : public Application
+{
+    URHO3D_OBJECT(NetBench, Application);
+
+public:
+    NetBench(Context* context);
+
+    virtual void Setup();
+    virtual void Start();
+
+protected:
+    void ParseArguments();
+    void RegisterObjects();
+    bool IsSuiteEnabled(const String &suite) const;
+    void Report(const String &suite, const String &name, float value, const String &unit);
+
+    /// Create a scene with a physics world and count ballers, optionally driven by a BallerSystem.
+    SharedPtr<Scene> CreateBallerScene(unsigned count, bool useSystem);
+
+    /// Baller movement: per-component FixedUpdate against the batched BallerSystem.
+    void BenchBallerMovement();
+    /// Area of interest: relevant set size and estimated bandwidth per client as population grows at fixed density.
+    void BenchInterest();
+    /// Transform stream: bytes per update moving and at rest against the attribute path, and quantization error.
+    void BenchTransformCodec();
+    /// Level collision: building the triangle mesh BVH in a fresh scene, cold against reusing the cooked data.
+    void BenchCollisionMesh();
+    /// Rooms: how many small rooms the simulation thread pool keeps at the tick rate on this machine.
+    void BenchRooms();
+    /// Lag compensation: rewinding the client object history and running a raycast and a sphere query against it.
+    void BenchLagCompensation();
+    /// Dormancy: full physics ticks of 1000 ballers, 80% of them idle, with and without dormancy.
+    void BenchDormancy();
+
+protected:
+    String suite_;
+    unsigned ticks_;
+};
@@ -0,0 +1,226 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/Network/Connection.h>
+#include <Urho3D/Network/Network.h>
+#include <Urho3D/Network/NetworkEvents.h>
+
+#include <kNet/MessageConnection.h>
+
+#include <cstdlib>
+
+#include "NetConditioner.h"
+
+#include <Urho3D/DebugNew.h>
+//=============================================================================
+//=============================================================================
+String NetConditions::ToString() const
+{
+    return Urho3D::ToString("latency=%dms jitter=%dms loss=%.3f dup=%.3f bandwidth=%uB/s queue=%dms seed=%u",
+        latencyMs_, jitterMs_, loss_, duplication_, bandwidth_, queueMs_, seed_);
+}
+
+//=============================================================================
+//=============================================================================
+NetConditioner::NetConditioner(Context* context)
+    : Object(context)
+{
+    SubscribeToEvent(E_CLIENTCONNECTED, URHO3D_HANDLER(NetConditioner, HandleClientConnected));
+    SubscribeToEvent(E_CLIENTDISCONNECTED, URHO3D_HANDLER(NetConditioner, HandleClientDisconnected));
+    SubscribeToEvent(E_SERVERCONNECTED, URHO3D_HANDLER(NetConditioner, HandleServerConnected));
+    SubscribeToEvent(E_SERVERDISCONNECTED, URHO3D_HANDLER(NetConditioner, HandleServerDisconnected));
+    SubscribeToEvent(E_CONNECTFAILED, URHO3D_HANDLER(NetConditioner, HandleServerDisconnected));
+    SubscribeToEvent(E_NETWORKUPDATESENT, URHO3D_HANDLER(NetConditioner, HandleNetworkUpdateSent));
+}
+
+NetConditioner::~NetConditioner()
+{
+}
+
+void NetConditioner::SetConditions(const NetConditions& conditions)
+{
+    conditions_ = conditions;
+
+    if (conditions_.IsEnabled())
+    {
+        URHO3D_LOGINFOF("simulated network conditions: %s", conditions_.ToString().CString());
+    }
+
+    Network* network = GetSubsystem<Network>();
+    Connection* serverConnection = network->GetServerConnection();
+    if (serverConnection)
+    {
+        Apply(serverConnection);
+    }
+
+    const Vector<SharedPtr<Connection> >& connections = network->GetClientConnections();
+    for (unsigned i = 0; i < connections.Size(); ++i)
+    {
+        Apply(connections[i]);
+    }
+}
+
+float NetConditioner::GetQueueDelay(Connection *connection) const
+{
+    HashMap<Connection*, LinkState>::ConstIterator it = links_.Find(connection);
+    if (it == links_.End() || !conditions_.bandwidth_)
+        return 0.0f;
+
+    return it->second_.backlog_ * 1000.0f / conditions_.bandwidth_;
+}
+
+bool NetConditioner::ParseArgument(const String &argument, const String &value, NetConditions& conditions)
+{
+    if (argument == "-netlatency")
+        conditions.latencyMs_ = Max(ToInt(value), 0);
+    else if (argument == "-netjitter")
+        conditions.jitterMs_ = Max(ToInt(value), 0);
+    else if (argument == "-netloss")
+        conditions.loss_ = Clamp(ToFloat(value), 0.0f, 1.0f);
+    else if (argument == "-netdup")
+        conditions.duplication_ = Clamp(ToFloat(value), 0.0f, 1.0f);
+    else if (argument == "-netbandwidth")
+        conditions.bandwidth_ = ToUInt(value);
+    else if (argument == "-netqueue")
+        conditions.queueMs_ = Max(ToInt(value), 1);
+    else if (argument == "-netseed")
+        conditions.seed_ = ToUInt(value);
+    else
+        return false;
+
+    return true;
+}
+
+void NetConditioner::SeedRandom(unsigned seed)
+{
+    // kNet's simulator rolls with rand()
+    if (seed)
+    {
+        srand(seed);
+        SetRandomSeed(seed);
+    }
+    else
+    {
+        SetRandomSeed(Time::GetSystemTime());
+    }
+}
+
+int NetConditioner::GetBaseLatency() const
+{
+    return GetSubsystem<Network>()->GetSimulatedLatency();
+}
+
+float NetConditioner::GetBaseLoss() const
+{
+    return GetSubsystem<Network>()->GetSimulatedPacketLoss();
+}
+
+void NetConditioner::Apply(Connection *connection)
+{
+    kNet::MessageConnection* messageConnection = connection->GetMessageConnection();
+    if (!conditions_.IsEnabled() || !messageConnection)
+        return;
+
+    // the engine configures the same simulator from Network::SetSimulatedLatency/PacketLoss when the connection opens,
+    // these stack on top of it: delays add up, and a packet gets through only if neither drops it
+    kNet::NetworkSimulator& simulator = messageConnection->NetworkSendSimulator();
+    simulator.enabled = true;
+    simulator.constantPacketSendDelay = (float)(GetBaseLatency() + conditions_.latencyMs_);
+    simulator.uniformRandomPacketSendDelay = (float)conditions_.jitterMs_;
+    simulator.packetLossRate = 1.0f - (1.0f - GetBaseLoss()) * (1.0f - conditions_.loss_);
+    simulator.packetDuplicationRate = conditions_.duplication_;
+
+    links_[connection] = LinkState();
+}
+
+void NetConditioner::UpdateBandwidth(float timeStep)
+{
+    const float bandwidth = (float)conditions_.bandwidth_;
+    const float queueLimit = bandwidth * conditions_.queueMs_ / 1000.0f;
+    const float latency = (float)(GetBaseLatency() + conditions_.latencyMs_);
+    const float delivery = (1.0f - GetBaseLoss()) * (1.0f - conditions_.loss_);
+
+    for (HashMap<Connection*, LinkState>::Iterator it = links_.Begin(); it != links_.End(); ++it)
+    {
+        Connection* connection = it->first_;
+        LinkState& link = it->second_;
+        kNet::MessageConnection* messageConnection = connection->GetMessageConnection();
+        if (!messageConnection)
+            continue;
+
+        // what is offered above the bandwidth queues up, the queue drains at the bandwidth
+        float offered = connection->GetBytesOutPerSec();
+        link.backlog_ = Max(link.backlog_ + (offered - bandwidth) * timeStep, 0.0f);
+
+        // a full queue drops the share of the traffic the link can't carry
+        float overflow = 0.0f;
+        if (link.backlog_ > queueLimit)
+        {
+            link.backlog_ = queueLimit;
+            overflow = offered > bandwidth ? 1.0f - bandwidth / offered : 0.0f;
+        }
+
+        kNet::NetworkSimulator& simulator = messageConnection->NetworkSendSimulator();
+        simulator.constantPacketSendDelay = latency + link.backlog_ * 1000.0f / bandwidth;
+        simulator.packetLossRate = 1.0f - delivery * (1.0f - overflow);
+    }
+}
+
+void NetConditioner::HandleClientConnected(StringHash eventType, VariantMap& eventData)
+{
+    using namespace ClientConnected;
+
+    Apply(static_cast<Connection*>(eventData[P_CONNECTION].GetPtr()));
+}
+
+void NetConditioner::HandleClientDisconnected(StringHash eventType, VariantMap& eventData)
+{
+    using namespace ClientDisconnected;
+
+    links_.Erase(static_cast<Connection*>(eventData[P_CONNECTION].GetPtr()));
+}
+
+void NetConditioner::HandleServerConnected(StringHash eventType, VariantMap& eventData)
+{
+    Connection* serverConnection = GetSubsystem<Network>()->GetServerConnection();
+    if (serverConnection)
+    {
+        Apply(serverConnection);
+    }
+}
+
+void NetConditioner::HandleServerDisconnected(StringHash eventType, VariantMap& eventData)
+{
+    links_.Clear();
+}
+
+void NetConditioner::HandleNetworkUpdateSent(StringHash eventType, VariantMap& eventData)
+{
+    float timeStep = updateTimer_.GetUSec(true) / 1000000.0f;
+
+    if (conditions_.bandwidth_ && !links_.Empty())
+    {
+        UpdateBandwidth(timeStep);
+    }
+}
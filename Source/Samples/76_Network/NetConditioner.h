@@ -0,0 +1,126 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Core/Timer.h>
+
+namespace Urho3D
+{
+class Connection;
+}
+
+using namespace Urho3D;
+//=============================================================================
+//=============================================================================
+/// Simulated link impairments for the packets a process sends.
+struct NetConditions
+{
+    NetConditions()
+        : latencyMs_(0)
+        , jitterMs_(0)
+        , loss_(0.0f)
+        , duplication_(0.0f)
+        , bandwidth_(0)
+        , queueMs_(250)
+        , seed_(0)
+    {
+    }
+
+    bool IsEnabled() const { return latencyMs_ > 0 || jitterMs_ > 0 || loss_ > 0.0f || duplication_ > 0.0f || bandwidth_ > 0; }
+    String ToString() const;
+
+    /// Fixed delay, and a uniformly random extra delay up to jitterMs_ per packet, which also reorders packets sent
+    /// closer together than the jitter.
+    int latencyMs_;
+    int jitterMs_;
+    /// Packet loss and duplication rates, 0-1.
+    float loss_;
+    float duplication_;
+    /// Bottleneck bandwidth in bytes/sec, 0 is unlimited, and how many ms of it the bottleneck queues before dropping.
+    unsigned bandwidth_;
+    int queueMs_;
+    /// Seed for the impairment rolls, passed to NetConditioner::SeedRandom once per process. 0 seeds by time.
+    unsigned seed_;
+};
+
+//=============================================================================
+//=============================================================================
+/// Applies NetConditions to every connection of this process's Network: a server impairs what it sends to each
+/// client, a client what it sends to the server. Latency, jitter, loss and duplication are kNet's per-connection send
+/// simulator, added to the latency and loss the engine was given through Network::SetSimulatedLatency/PacketLoss, e.g. a
+/// bot's slow link. The bandwidth cap is a fluid model of a bottleneck queue on top of it: traffic sent above the
+/// bandwidth builds a backlog that adds queueing delay as it drains, and what overflows the queue is dropped.
+///
+/// command line: [-netlatency <ms>] [-netjitter <ms>] [-netloss <0-1>] [-netdup <0-1>] [-netbandwidth <bytes/s>]
+///               [-netqueue <ms>] [-netseed <n>]
+class NetConditioner : public Object
+{
+    URHO3D_OBJECT(NetConditioner, Object);
+
+public:
+    NetConditioner(Context* context);
+    virtual ~NetConditioner();
+
+    /// Set the conditions, open connections included.
+    void SetConditions(const NetConditions& conditions);
+    const NetConditions& GetConditions() const { return conditions_; }
+    /// Return the simulated queueing delay of a connection in ms, 0 without a bandwidth cap.
+    float GetQueueDelay(Connection *connection) const;
+
+    /// Parse one of the command line options above, returns false if the argument isn't one of them.
+    static bool ParseArgument(const String &argument, const String &value, NetConditions& conditions);
+    /// Seed the C and engine random generators, or the engine's by time for 0. The same seed repeats the same sequence
+    /// of drops and delays. Call once per process, every conditioner in it rolls from the same generator.
+    static void SeedRandom(unsigned seed);
+
+protected:
+    /// Bottleneck queue of one connection, bytes.
+    struct LinkState
+    {
+        LinkState()
+            : backlog_(0.0f)
+        {
+        }
+
+        float backlog_;
+    };
+
+    void Apply(Connection *connection);
+    void UpdateBandwidth(float timeStep);
+    /// Return the engine's simulated latency in ms and loss rate, which the conditions add to.
+    int GetBaseLatency() const;
+    float GetBaseLoss() const;
+
+    void HandleClientConnected(StringHash eventType, VariantMap& eventData);
+    void HandleClientDisconnected(StringHash eventType, VariantMap& eventData);
+    void HandleServerConnected(StringHash eventType, VariantMap& eventData);
+    void HandleServerDisconnected(StringHash eventType, VariantMap& eventData);
+    void HandleNetworkUpdateSent(StringHash eventType, VariantMap& eventData);
+
+protected:
+    NetConditions conditions_;
+    HashMap<Connection*, LinkState> links_;
+    HiresTimer updateTimer_;
+};
@@ -0,0 +1,254 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/ProcessUtils.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Engine/Engine.h>
+#include <Urho3D/Graphics/Model.h>
+#include <Urho3D/IO/FileSystem.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/Physics/CollisionShape.h>
+#include <Urho3D/Physics/PhysicsWorld.h>
+#include <Urho3D/Physics/RigidBody.h>
+#include <Urho3D/Resource/ResourceCache.h>
+#include <Urho3D/Scene/Scene.h>
+
+#include "NetReplay.h"
+#include "ClientObj.h"
+#include "Baller.h"
+#include "BallerSystem.h"
+#include "MaterialPalette.h"
+#include "CollisionMeshCache.h"
+#include "InputLog.h"
+
+#include <Urho3D/DebugNew.h>
+//=============================================================================
+//=============================================================================
+URHO3D_DEFINE_APPLICATION_MAIN(NetReplay)
+
+static inline unsigned HashBytes(unsigned hash, const void* data, unsigned size)
+{
+    // FNV-1a
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (unsigned i = 0; i < size; ++i)
+    {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+//=============================================================================
+//=============================================================================
+NetReplay::NetReplay(Context* context)
+    : Application(context)
+    , repeat_(1)
+{
+}
+
+void NetReplay::Setup()
+{
+    ParseArguments();
+
+    engineParameters_["LogName"]       = GetSubsystem<FileSystem>()->GetProgramDir() + "netreplay.log";
+    engineParameters_["Headless"]      = true;
+    engineParameters_["Sound"]         = false;
+    engineParameters_["ResourcePaths"] = "Data;CoreData;Data/NetDemo;";
+}
+
+void NetReplay::Start()
+{
+    if (logFile_.Empty())
+    {
+        ErrorExit("usage: 76_Network_Replay -log <file> [-repeat <n>]");
+        return;
+    }
+
+    RegisterObjects();
+
+    for (unsigned run = 0; run < repeat_; ++run)
+    {
+        if (!Replay(run))
+        {
+            ErrorExit(ToString("Failed to replay %s", logFile_.CString()));
+            return;
+        }
+    }
+
+    engine_->Exit();
+}
+
+void NetReplay::ParseArguments()
+{
+    const Vector<String>& arguments = GetArguments();
+
+    for (unsigned i = 0; i + 1 < arguments.Size(); ++i)
+    {
+        String argument = arguments[i].ToLower();
+        const String& value = arguments[i + 1];
+
+        if (argument == "-log")
+        {
+            logFile_ = value;
+            ++i;
+        }
+        else if (argument == "-repeat")
+        {
+            repeat_ = Max(ToUInt(value), 1U);
+            ++i;
+        }
+    }
+}
+
+void NetReplay::RegisterObjects()
+{
+    MaterialPalette* palette = new MaterialPalette(context_);
+    context_->RegisterSubsystem(palette);
+    palette->Load();
+
+    context_->RegisterSubsystem(new CollisionMeshCache(context_));
+
+    ClientObj::RegisterObject(context_);
+    Baller::RegisterObject(context_);
+    BallerSystem::RegisterObject(context_);
+}
+
+void NetReplay::CreateScene(int fps)
+{
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
+
+    // same as the dedicated server's scene
+    scene_ = new Scene(context_);
+    PhysicsWorld *physicsWorld = scene_->CreateComponent<PhysicsWorld>(LOCAL);
+    physicsWorld->SetFps(fps);
+    scene_->CreateComponent<BallerSystem>(LOCAL);
+
+    Node* floorNode = scene_->CreateChild("floor", LOCAL);
+    Model *model = cache->GetResource<Model>("NetDemo/level1.mdl");
+    floorNode->CreateComponent<RigidBody>();
+    CollisionShape* shape = floorNode->CreateComponent<CollisionShape>();
+    GetSubsystem<CollisionMeshCache>()->SetTriangleMesh(shape, model);
+}
+
+bool NetReplay::Replay(unsigned run)
+{
+    InputLogReader reader;
+    if (!reader.Open(context_, logFile_))
+        return false;
+
+    // the same seed every run, material swaps pick their colour at random
+    SetRandomSeed(1);
+    CreateScene(reader.GetFps());
+    clients_.Clear();
+
+    const float timeStep = 1.0f / (float)reader.GetFps();
+    InputLogRecord record;
+    unsigned numTicks = 0;
+    unsigned numJoins = 0;
+    Controls controls;
+
+    HiresTimer timer;
+
+    while (reader.Read(record))
+    {
+        if (record.type_ == INPUTREC_JOIN)
+        {
+            Node* clientNode = scene_->CreateChild("client");
+            clientNode->SetPosition(record.position_);
+
+            ClientObj* clientObj = clientNode->CreateComponent<Baller>();
+            clientObj->SetClientInfo(record.userName_, record.colorIdx_);
+            clientObj->Create();
+
+            clients_[record.clientId_] = clientObj;
+            ++numJoins;
+        }
+        else if (record.type_ == INPUTREC_LEAVE)
+        {
+            HashMap<unsigned, ClientObj*>::Iterator it = clients_.Find(record.clientId_);
+            if (it != clients_.End())
+            {
+                it->second_->GetNode()->Remove();
+                clients_.Erase(it);
+            }
+        }
+        else if (record.type_ == INPUTREC_TICK)
+        {
+            for (unsigned i = 0; i < record.controls_.Size(); ++i)
+            {
+                const InputLogControls& input = record.controls_[i];
+                HashMap<unsigned, ClientObj*>::Iterator it = clients_.Find(input.clientId_);
+
+                if (it != clients_.End())
+                {
+                    controls.buttons_ = input.buttons_;
+                    controls.yaw_ = input.yaw_;
+                    it->second_->SetControls(controls);
+                }
+            }
+
+            scene_->Update(timeStep);
+            ++numTicks;
+        }
+    }
+
+    long long elapsed = timer.GetUSec(false);
+    float ticksPerSec = elapsed > 0 ? numTicks * 1000000.0f / (float)elapsed : 0.0f;
+
+    String line = ToString("replay %u: ticks=%u joins=%u clients=%u time=%.1fms ticks/sec=%.1f checksum=%08x", run,
+        numTicks, numJoins, clients_.Size(), elapsed / 1000.0f, ticksPerSec, Checksum());
+    PrintLine(line);
+    URHO3D_LOGINFO(line);
+
+    clients_.Clear();
+    scene_.Reset();
+
+    return true;
+}
+
+unsigned NetReplay::Checksum() const
+{
+    unsigned hash = 2166136261u;
+
+    for (HashMap<unsigned, ClientObj*>::ConstIterator it = clients_.Begin(); it != clients_.End(); ++it)
+    {
+        ClientObj* clientObj = it->second_;
+        Node* clientNode = clientObj->GetNode();
+        RigidBody* body = clientNode->GetComponent<RigidBody>();
+
+        Vector3 position = clientNode->GetWorldPosition();
+        Quaternion rotation = clientNode->GetWorldRotation();
+        Vector3 linearVelocity = body ? body->GetLinearVelocity() : Vector3::ZERO;
+        Vector3 angularVelocity = body ? body->GetAngularVelocity() : Vector3::ZERO;
+        int colorIdx = clientObj->GetColorIdx();
+
+        hash = HashBytes(hash, &it->first_, sizeof(unsigned));
+        hash = HashBytes(hash, position.Data(), sizeof(Vector3));
+        hash = HashBytes(hash, rotation.Data(), sizeof(Quaternion));
+        hash = HashBytes(hash, linearVelocity.Data(), sizeof(Vector3));
+        hash = HashBytes(hash, angularVelocity.Data(), sizeof(Vector3));
+        hash = HashBytes(hash, &colorIdx, sizeof(int));
+    }
+
+    return hash;
+}
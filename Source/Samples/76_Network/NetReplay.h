@@ -0,0 +1,70 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Engine/Application.h>
+
+namespace Urho3D
+{
+class Scene;
+}
+
+using namespace Urho3D;
+//=============================================================================
+//=============================================================================
+class ClientObj;
+
+//=============================================================================
+//=============================================================================
+/// Headless replay of a server input log recorded with 76_Network_Server -record. Rebuilds the server's scene,
+/// spawns and removes client objects as recorded and steps the simulation one tick per recorded tick as fast as
+/// possible, with no network. Reports ticks/sec and a checksum of the final client object states, so the same log
+/// gives the same checksum as long as the simulation is unchanged.
+/// usage: 76_Network_Replay -log <file> [-repeat <n>]
+class NetReplay : public Application
+{
+    URHO3D_OBJECT(NetReplay, Application);
+
+public:
+    NetReplay(Context* context);
+
+    virtual void Setup();
+    virtual void Start();
+
+protected:
+    void ParseArguments();
+    void RegisterObjects();
+    void CreateScene(int fps);
+    /// Run the log once, returns false if it could not be read.
+    bool Replay(unsigned run);
+    unsigned Checksum() const;
+
+protected:
+    SharedPtr<Scene> scene_;
+    /// Live client objects by recorded id, iterated in join order.
+    HashMap<unsigned, ClientObj*> clients_;
+    String logFile_;
+    unsigned repeat_;
+};
@@ -0,0 +1,348 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/IO/File.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/Network/Connection.h>
+#include <Urho3D/Network/Network.h>
+#include <Urho3D/Network/NetworkEvents.h>
+#include <Urho3D/Physics/PhysicsEvents.h>
+#include <Urho3D/Scene/Node.h>
+
+#include "NetStats.h"
+#include "Server.h"
+#include "ClientObj.h"
+
+#include <Urho3D/DebugNew.h>
+//=============================================================================
+//=============================================================================
+// replicated attributes sent for a moved client node: position, rotation, linear and angular velocity, or the one
+// transform stream buffer with compact transforms
+static const unsigned MOVED_NODE_ATTRIBUTES = 4;
+static const unsigned MOVED_NODE_ATTRIBUTES_COMPACT = 1;
+
+static const char* stageNames[] =
+{
+    "input",
+    "physics",
+    "replication"
+};
+
+//=============================================================================
+//=============================================================================
+NetStats::NetStats(Context* context)
+    : Object(context)
+    , dumpJSON_(false)
+    , dumpInterval_(0.0f)
+    , dumpAcc_(0.0f)
+{
+    SubscribeToEvents();
+}
+
+NetStats::~NetStats()
+{
+}
+
+bool NetStats::SetDumpFile(const String &fileName, float interval)
+{
+    dumpFile_ = new File(context_, fileName, FILE_WRITE);
+
+    if (!dumpFile_->IsOpen())
+    {
+        URHO3D_LOGERRORF("NetStats could not open %s", fileName.CString());
+        dumpFile_.Reset();
+        return false;
+    }
+
+    dumpJSON_ = fileName.EndsWith(".json", false);
+    dumpInterval_ = interval;
+    dumpAcc_ = 0.0f;
+
+    if (!dumpJSON_)
+    {
+        dumpFile_->WriteLine("time,kind,name,bytes_in,bytes_out,packets_in,packets_out,node_deltas,attribute_deltas,"
+                             "remote_events,rtt_ms,avg_us,max_us,count");
+    }
+
+    return true;
+}
+
+const char* NetStats::GetStageName(NetStage stage)
+{
+    return stageNames[stage];
+}
+
+void NetStats::BeginStage(NetStage stage)
+{
+    stageTimers_[stage].Reset();
+}
+
+void NetStats::EndStage(NetStage stage)
+{
+    long long usec = stageTimers_[stage].GetUSec(false);
+
+    StageStats& stats = stageStats_[stage];
+    stats.totalUSec_ += usec;
+    stats.maxUSec_ = Max(stats.maxUSec_, usec);
+    ++stats.count_;
+}
+
+void NetStats::AddRemoteEvent(Connection *connection)
+{
+    ConnectionStats& stats = connectionStats_[connection];
+    ++stats.remoteEvents_;
+    ++stats.intervalRemoteEvents_;
+}
+
+const ConnectionStats* NetStats::GetConnectionStats(Connection *connection) const
+{
+    HashMap<Connection*, ConnectionStats>::ConstIterator it = connectionStats_.Find(connection);
+    return it != connectionStats_.End() ? &it->second_ : NULL;
+}
+
+void NetStats::SubscribeToEvents()
+{
+    SubscribeToEvent(E_NETWORKUPDATE, URHO3D_HANDLER(NetStats, HandleNetworkUpdate));
+    SubscribeToEvent(E_NETWORKUPDATESENT, URHO3D_HANDLER(NetStats, HandleNetworkUpdateSent));
+    SubscribeToEvent(E_PHYSICSPRESTEP, URHO3D_HANDLER(NetStats, HandlePhysicsPreStep));
+    SubscribeToEvent(E_PHYSICSPOSTSTEP, URHO3D_HANDLER(NetStats, HandlePhysicsPostStep));
+    SubscribeToEvent(E_CLIENTDISCONNECTED, URHO3D_HANDLER(NetStats, HandleClientDisconnected));
+}
+
+void NetStats::SampleConnections(float timeStep)
+{
+    const Vector<SharedPtr<Connection> >& connections = GetSubsystem<Network>()->GetClientConnections();
+
+    // The engine keeps per-second rates per connection, integrate them over the time since the last sample
+    for (unsigned i = 0; i < connections.Size(); ++i)
+    {
+        Connection* connection = connections[i];
+        ConnectionStats& stats = connectionStats_[connection];
+
+        if (stats.address_.Empty())
+        {
+            stats.address_ = connection->ToString();
+        }
+
+        double bytesIn = connection->GetBytesInPerSec() * timeStep;
+        double bytesOut = connection->GetBytesOutPerSec() * timeStep;
+
+        double packetsIn = connection->GetPacketsInPerSec() * timeStep;
+        double packetsOut = connection->GetPacketsOutPerSec() * timeStep;
+
+        stats.bytesIn_ += bytesIn;
+        stats.bytesOut_ += bytesOut;
+        stats.packetsIn_ += packetsIn;
+        stats.packetsOut_ += packetsOut;
+        stats.intervalBytesIn_ += bytesIn;
+        stats.intervalBytesOut_ += bytesOut;
+        stats.intervalPacketsIn_ += packetsIn;
+        stats.intervalPacketsOut_ += packetsOut;
+        stats.roundTripTime_ = connection->GetRoundTripTime() * 1000.0f;
+    }
+}
+
+void NetStats::CountNodeDeltas()
+{
+    Server* server = GetSubsystem<Server>();
+    if (!server)
+        return;
+
+    const Vector<ClientSlot>& clients = server->GetClients();
+    const unsigned attributesPerNode = server->GetCompactTransforms() ? MOVED_NODE_ATTRIBUTES_COMPACT : MOVED_NODE_ATTRIBUTES;
+
+    // client objects flag themselves when their node moves, that is what the engine sends as deltas
+    movedClients_.Resize(clients.Size());
+    for (unsigned i = 0; i < clients.Size(); ++i)
+    {
+        movedClients_[i] = clients[i].clientObj_->ConsumeNetDirty();
+    }
+
+    for (unsigned i = 0; i < clients.Size(); ++i)
+    {
+        const ClientSlot& client = clients[i];
+        if (!client.connection_->GetScene())
+            continue;
+
+        // an update the adaptive rate skipped sent only the connection's own object. A node that moved only during
+        // skipped updates goes out on the next sent one, where it is counted if it is still moving
+        relevantClients_.Clear();
+        if (client.updateAcc_ != 0)
+        {
+            relevantClients_.Push(i);
+        }
+        else if (server->GetInterestRadius() > 0.0f)
+        {
+            server->GetRelevantClients(i, relevantClients_);
+        }
+        else
+        {
+            for (unsigned j = 0; j < clients.Size(); ++j)
+            {
+                if (clients[j].room_ == client.room_)
+                    relevantClients_.Push(j);
+            }
+        }
+
+        unsigned nodeDeltas = 0;
+        for (unsigned j = 0; j < relevantClients_.Size(); ++j)
+        {
+            if (movedClients_[relevantClients_[j]])
+                ++nodeDeltas;
+        }
+
+        ConnectionStats& stats = connectionStats_[client.connection_];
+        stats.nodeDeltas_ += nodeDeltas;
+        stats.attributeDeltas_ += nodeDeltas * attributesPerNode;
+        stats.intervalNodeDeltas_ += nodeDeltas;
+        stats.intervalAttributeDeltas_ += nodeDeltas * attributesPerNode;
+    }
+}
+
+void NetStats::Dump()
+{
+    if (!dumpFile_)
+        return;
+
+    unsigned time = Time::GetSystemTime();
+
+    if (dumpJSON_)
+    {
+        String line = ToString("{\"time\":%u,\"connections\":[", time);
+
+        unsigned n = 0;
+        for (HashMap<Connection*, ConnectionStats>::ConstIterator it = connectionStats_.Begin(); it != connectionStats_.End(); ++it, ++n)
+        {
+            const ConnectionStats& stats = it->second_;
+            line += ToString("%s{\"name\":\"%s\",\"bytes_in\":%.0f,\"bytes_out\":%.0f,\"packets_in\":%.0f,\"packets_out\":%.0f,"
+                "\"node_deltas\":%u,\"attribute_deltas\":%u,\"remote_events\":%u,\"rtt_ms\":%.1f}",
+                n ? "," : "", stats.address_.CString(), stats.intervalBytesIn_, stats.intervalBytesOut_,
+                stats.intervalPacketsIn_, stats.intervalPacketsOut_, stats.intervalNodeDeltas_, stats.intervalAttributeDeltas_,
+                stats.intervalRemoteEvents_, stats.roundTripTime_);
+        }
+
+        line += "],\"stages\":{";
+
+        for (unsigned i = 0; i < MAX_NETSTAGES; ++i)
+        {
+            const StageStats& stats = stageStats_[i];
+            line += ToString("%s\"%s\":{\"avg_us\":%.1f,\"max_us\":%lld,\"count\":%u}",
+                i ? "," : "", stageNames[i], stats.GetAverageUSec(), stats.maxUSec_, stats.count_);
+        }
+
+        line += "}}";
+        dumpFile_->WriteLine(line);
+    }
+    else
+    {
+        for (HashMap<Connection*, ConnectionStats>::ConstIterator it = connectionStats_.Begin(); it != connectionStats_.End(); ++it)
+        {
+            const ConnectionStats& stats = it->second_;
+            dumpFile_->WriteLine(ToString("%u,connection,%s,%.0f,%.0f,%.0f,%.0f,%u,%u,%u,%.1f,,,",
+                time, stats.address_.CString(), stats.intervalBytesIn_, stats.intervalBytesOut_,
+                stats.intervalPacketsIn_, stats.intervalPacketsOut_, stats.intervalNodeDeltas_, stats.intervalAttributeDeltas_,
+                stats.intervalRemoteEvents_, stats.roundTripTime_));
+        }
+
+        for (unsigned i = 0; i < MAX_NETSTAGES; ++i)
+        {
+            const StageStats& stats = stageStats_[i];
+            dumpFile_->WriteLine(ToString("%u,stage,%s,,,,,,,,,%.1f,%lld,%u",
+                time, stageNames[i], stats.GetAverageUSec(), stats.maxUSec_, stats.count_));
+        }
+    }
+
+    dumpFile_->Flush();
+}
+
+void NetStats::ResetInterval()
+{
+    for (HashMap<Connection*, ConnectionStats>::Iterator it = connectionStats_.Begin(); it != connectionStats_.End(); ++it)
+    {
+        ConnectionStats& stats = it->second_;
+        stats.intervalBytesIn_ = 0.0;
+        stats.intervalBytesOut_ = 0.0;
+        stats.intervalPacketsIn_ = 0.0;
+        stats.intervalPacketsOut_ = 0.0;
+        stats.intervalNodeDeltas_ = 0;
+        stats.intervalAttributeDeltas_ = 0;
+        stats.intervalRemoteEvents_ = 0;
+    }
+
+    for (unsigned i = 0; i < MAX_NETSTAGES; ++i)
+    {
+        stageStats_[i] = StageStats();
+    }
+}
+
+void NetStats::HandleNetworkUpdate(StringHash eventType, VariantMap& eventData)
+{
+    if (!GetSubsystem<Network>()->IsServerRunning())
+        return;
+
+    BeginStage(STAGE_REPLICATION);
+}
+
+void NetStats::HandleNetworkUpdateSent(StringHash eventType, VariantMap& eventData)
+{
+    if (!GetSubsystem<Network>()->IsServerRunning())
+        return;
+
+    EndStage(STAGE_REPLICATION);
+
+    // after the server picked this update's interest sets and skips, and the engine sent it
+    CountNodeDeltas();
+
+    float timeStep = sampleTimer_.GetUSec(true) / 1000000.0f;
+    SampleConnections(timeStep);
+
+    if (dumpFile_)
+    {
+        dumpAcc_ += timeStep;
+
+        if (dumpAcc_ >= dumpInterval_)
+        {
+            Dump();
+            ResetInterval();
+            dumpAcc_ = 0.0f;
+        }
+    }
+}
+
+void NetStats::HandlePhysicsPreStep(StringHash eventType, VariantMap& eventData)
+{
+    BeginStage(STAGE_PHYSICS);
+}
+
+void NetStats::HandlePhysicsPostStep(StringHash eventType, VariantMap& eventData)
+{
+    EndStage(STAGE_PHYSICS);
+}
+
+void NetStats::HandleClientDisconnected(StringHash eventType, VariantMap& eventData)
+{
+    using namespace ClientDisconnected;
+
+    Connection* connection = static_cast<Connection*>(eventData[P_CONNECTION].GetPtr());
+    connectionStats_.Erase(connection);
+}
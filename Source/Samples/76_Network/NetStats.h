@@ -0,0 +1,182 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Core/Timer.h>
+
+namespace Urho3D
+{
+class Connection;
+class File;
+}
+
+using namespace Urho3D;
+//=============================================================================
+//=============================================================================
+/// Server frame stages that are timed.
+enum NetStage
+{
+    STAGE_INPUT = 0,
+    STAGE_PHYSICS,
+    STAGE_REPLICATION,
+    MAX_NETSTAGES
+};
+
+/// Rolling per-connection counters, totals since connect and counts for the current dump interval. Node and attribute
+/// deltas count the moved client objects the connection was sent on each network update: those in its interest area,
+/// or only its own on an update its adaptive rate skips.
+struct ConnectionStats
+{
+    ConnectionStats()
+        : bytesIn_(0.0)
+        , bytesOut_(0.0)
+        , packetsIn_(0.0)
+        , packetsOut_(0.0)
+        , nodeDeltas_(0)
+        , attributeDeltas_(0)
+        , remoteEvents_(0)
+        , intervalBytesIn_(0.0)
+        , intervalBytesOut_(0.0)
+        , intervalPacketsIn_(0.0)
+        , intervalPacketsOut_(0.0)
+        , intervalNodeDeltas_(0)
+        , intervalAttributeDeltas_(0)
+        , intervalRemoteEvents_(0)
+        , roundTripTime_(0.0f)
+    {
+    }
+
+    String address_;
+    double bytesIn_;
+    double bytesOut_;
+    double packetsIn_;
+    double packetsOut_;
+    unsigned nodeDeltas_;
+    unsigned attributeDeltas_;
+    unsigned remoteEvents_;
+    double intervalBytesIn_;
+    double intervalBytesOut_;
+    double intervalPacketsIn_;
+    double intervalPacketsOut_;
+    unsigned intervalNodeDeltas_;
+    unsigned intervalAttributeDeltas_;
+    unsigned intervalRemoteEvents_;
+    float roundTripTime_;
+};
+
+/// Timing of one server frame stage over the current dump interval.
+struct StageStats
+{
+    StageStats()
+        : totalUSec_(0)
+        , maxUSec_(0)
+        , count_(0)
+    {
+    }
+
+    float GetAverageUSec() const { return count_ ? (float)totalUSec_ / (float)count_ : 0.0f; }
+
+    long long totalUSec_;
+    long long maxUSec_;
+    unsigned count_;
+};
+
+//=============================================================================
+//=============================================================================
+/// Server-side replication bandwidth and frame cost instrumentation. Hooks the network update cycle to keep rolling
+/// per-connection counters and times the input dispatch, physics and replication stages of the server frame.
+class NetStats : public Object
+{
+    URHO3D_OBJECT(NetStats, Object);
+
+public:
+    NetStats(Context* context);
+    virtual ~NetStats();
+
+    /// Periodically dump to a file, format chosen by extension: .json writes one object per line, anything else csv.
+    bool SetDumpFile(const String &fileName, float interval);
+
+    void BeginStage(NetStage stage);
+    void EndStage(NetStage stage);
+    void AddRemoteEvent(Connection *connection);
+
+    const HashMap<Connection*, ConnectionStats>& GetConnectionStats() const { return connectionStats_; }
+    const ConnectionStats* GetConnectionStats(Connection *connection) const;
+    const StageStats& GetStageStats(NetStage stage) const { return stageStats_[stage]; }
+    static const char* GetStageName(NetStage stage);
+
+protected:
+    void SubscribeToEvents();
+    void SampleConnections(float timeStep);
+    /// Credit each connection with the moved client objects it was sent this network update.
+    void CountNodeDeltas();
+    void Dump();
+    void ResetInterval();
+
+    void HandleNetworkUpdate(StringHash eventType, VariantMap& eventData);
+    void HandleNetworkUpdateSent(StringHash eventType, VariantMap& eventData);
+    void HandlePhysicsPreStep(StringHash eventType, VariantMap& eventData);
+    void HandlePhysicsPostStep(StringHash eventType, VariantMap& eventData);
+    void HandleClientDisconnected(StringHash eventType, VariantMap& eventData);
+
+protected:
+    HashMap<Connection*, ConnectionStats> connectionStats_;
+    StageStats stageStats_[MAX_NETSTAGES];
+    HiresTimer stageTimers_[MAX_NETSTAGES];
+
+    /// CountNodeDeltas scratch, per client slot.
+    PODVector<bool> movedClients_;
+    PODVector<unsigned> relevantClients_;
+
+    HiresTimer sampleTimer_;
+    SharedPtr<File> dumpFile_;
+    bool dumpJSON_;
+    float dumpInterval_;
+    float dumpAcc_;
+};
+
+//=============================================================================
+//=============================================================================
+/// Times a stage for the lifetime of the scope, does nothing without a NetStats subsystem.
+class NetStatsScope
+{
+public:
+    NetStatsScope(NetStats* netStats, NetStage stage)
+        : netStats_(netStats)
+        , stage_(stage)
+    {
+        if (netStats_)
+            netStats_->BeginStage(stage_);
+    }
+
+    ~NetStatsScope()
+    {
+        if (netStats_)
+            netStats_->EndStage(stage_);
+    }
+
+private:
+    NetStats* netStats_;
+    NetStage stage_;
+};
@@ -0,0 +1,669 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <Urho3D/Core/CoreEvents.h>
+#include <Urho3D/Core/ProcessUtils.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Engine/Engine.h>
+#include <Urho3D/Graphics/Model.h>
+#include <Urho3D/Input/Controls.h>
+#include <Urho3D/IO/File.h>
+#include <Urho3D/IO/FileSystem.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/Network/Network.h>
+#include <Urho3D/Physics/CollisionShape.h>
+#include <Urho3D/Physics/PhysicsEvents.h>
+#include <Urho3D/Physics/PhysicsWorld.h>
+#include <Urho3D/Physics/RigidBody.h>
+#include <Urho3D/Resource/ResourceCache.h>
+#include <Urho3D/Resource/XMLFile.h>
+#include <Urho3D/Scene/Scene.h>
+
+#include "ReplicationTest.h"
+#include "Server.h"
+#include "ClientObj.h"
+#include "Baller.h"
+#include "BallerSystem.h"
+#include "TickProfiler.h"
+#include "MaterialPalette.h"
+#include "CollisionMeshCache.h"
+#include "ResourcePreloader.h"
+
+#include <Urho3D/DebugNew.h>
+//=============================================================================
+//=============================================================================
+URHO3D_DEFINE_APPLICATION_MAIN(ReplicationTest)
+
+static const float LATE_JOIN_SETTLE = 0.5f;
+
+ReplicationTest::ReplicationTest(Context* context)
+    : Application(context)
+    , phase_(PHASE_LOADING)
+    , phaseTime_(0.0f)
+    , port_(SERVER_PORT)
+    , tickRate_(60)
+    , numClients_(16)
+    , warmup_(1.0f)
+    , duration_(3.0f)
+    , joinTimeout_(10.0f)
+    , compactTransforms_(false)
+    , dormancyTime_(1.0f)
+    , interestRadius_(0.0f)
+    , density_(0.0f)
+    , tolerance_(-1.0f)
+    , updateBaseline_(false)
+    , bytesInSum_(0.0f)
+    , bytesOutSum_(0.0f)
+    , numBandwidthSamples_(0)
+    , relevantSum_(0.0f)
+    , divergenceSum_(0.0f)
+    , divergenceMax_(0.0f)
+    , numDivergenceSamples_(0)
+    , lateJoinTime_(-1.0f)
+{
+}
+
+void ReplicationTest::Setup()
+{
+    ParseArguments();
+
+    engineParameters_["LogName"]       = GetSubsystem<FileSystem>()->GetProgramDir() + "netrepltest.log";
+    engineParameters_["Headless"]      = true;
+    engineParameters_["Sound"]         = false;
+    engineParameters_["ResourcePaths"] = "Data;CoreData;Data/NetDemo;";
+
+    // the test harness passes -timeout, and an engine timeout exits with success before any result is in. Every phase
+    // has its own limit instead
+    engineParameters_["TimeOut"]       = 0;
+
+    if (outputFile_.Empty())
+    {
+        outputFile_ = GetSubsystem<FileSystem>()->GetProgramDir() + "netrepltest.json";
+    }
+}
+
+void ReplicationTest::Start()
+{
+    // same bot identities and scripts every run
+    SetRandomSeed(1);
+
+    GetSubsystem<Engine>()->SetMaxFps(tickRate_);
+    GetSubsystem<Network>()->SetUpdateFps(tickRate_);
+
+    CreateServerSubsystem();
+
+    SubscribeToEvent(E_UPDATE, URHO3D_HANDLER(ReplicationTest, HandleUpdate));
+
+    preloader_ = new ResourcePreloader(context_);
+    SubscribeToEvent(preloader_, E_PRELOADFINISHED, URHO3D_HANDLER(ReplicationTest, HandlePreloadFinished));
+    preloader_->LoadManifest("NetDemo/Preload.xml");
+}
+
+void ReplicationTest::Stop()
+{
+    if (phase_ != PHASE_DONE)
+    {
+        URHO3D_LOGERROR("replication test ended before its results");
+        exitCode_ = EXIT_FAILURE;
+    }
+
+    for (unsigned i = 0; i < clients_.Size(); ++i)
+    {
+        clients_[i]->Disconnect();
+    }
+
+    // bots must go before the contexts that own their subsystems
+    lateClient_.Reset();
+    clients_.Clear();
+    clientContexts_.Clear();
+
+    GetSubsystem<Server>()->Disconnect();
+}
+
+void ReplicationTest::ParseArguments()
+{
+    const Vector<String>& arguments = GetArguments();
+
+    for (unsigned i = 0; i < arguments.Size(); ++i)
+    {
+        String argument = arguments[i].ToLower();
+
+        // flags
+        if (argument == "-compact")
+        {
+            compactTransforms_ = true;
+            continue;
+        }
+        if (argument == "-updatebaseline")
+        {
+            updateBaseline_ = true;
+            continue;
+        }
+
+        if (i + 1 >= arguments.Size())
+            break;
+
+        const String& value = arguments[i + 1];
+
+        if (argument == "-clients")
+        {
+            numClients_ = Max(ToUInt(value), 1U);
+            ++i;
+        }
+        else if (argument == "-warmup")
+        {
+            warmup_ = Max(ToFloat(value), 0.0f);
+            ++i;
+        }
+        else if (argument == "-duration")
+        {
+            duration_ = Max(ToFloat(value), 0.5f);
+            ++i;
+        }
+        else if (argument == "-jointimeout")
+        {
+            joinTimeout_ = Max(ToFloat(value), 1.0f);
+            ++i;
+        }
+        else if (argument == "-port")
+        {
+            port_ = (unsigned short)ToUInt(value);
+            ++i;
+        }
+        else if (argument == "-dormancy")
+        {
+            dormancyTime_ = Max(ToFloat(value), 0.0f);
+            ++i;
+        }
+        else if (argument == "-interest")
+        {
+            interestRadius_ = Max(ToFloat(value), 0.0f);
+            ++i;
+        }
+        else if (argument == "-density")
+        {
+            density_ = Max(ToFloat(value), 0.0f);
+            ++i;
+        }
+        else if (argument == "-output")
+        {
+            outputFile_ = value;
+            ++i;
+        }
+        else if (argument == "-baseline")
+        {
+            baselineFile_ = value;
+            ++i;
+        }
+        else if (argument == "-tolerance")
+        {
+            tolerance_ = Max(ToFloat(value), 0.0f);
+            ++i;
+        }
+    }
+}
+
+void ReplicationTest::CreateServerSubsystem()
+{
+    // server tick times, no dumps from a test run
+    TickProfiler* profiler = new TickProfiler(context_);
+    context_->RegisterSubsystem(profiler);
+    profiler->SetRecorderLength(2.0f, tickRate_ * 2);
+    profiler->SetTickBudget(0.0f, String::EMPTY);
+
+    Server* server = new Server(context_);
+    context_->RegisterSubsystem(server);
+    server->SetCompactTransforms(compactTransforms_);
+    server->SetDormancyTime(dormancyTime_);
+    server->SetInterestRadius(interestRadius_);
+
+    // the same density at any client count, the late joiner included
+    if (density_ > 0.0f)
+    {
+        server->SetSpawnSize(Sqrt((numClients_ + 1) * density_));
+    }
+
+    context_->RegisterSubsystem(new MaterialPalette(context_));
+    context_->RegisterSubsystem(new CollisionMeshCache(context_));
+
+    ClientObj::RegisterObject(context_);
+    Baller::RegisterObject(context_);
+    BallerSystem::RegisterObject(context_);
+}
+
+void ReplicationTest::CreateScene()
+{
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
+
+    // the dedicated server's scene: physics, the batched baller movement and the level collision
+    scene_ = new Scene(context_);
+    PhysicsWorld *physicsWorld = scene_->CreateComponent<PhysicsWorld>(LOCAL);
+    physicsWorld->SetFps(tickRate_);
+    scene_->CreateComponent<BallerSystem>(LOCAL);
+
+    Node* floorNode = scene_->CreateChild("floor", LOCAL);
+    Model *model = cache->GetResource<Model>("NetDemo/level1.mdl");
+    floorNode->CreateComponent<RigidBody>();
+    CollisionShape* shape = floorNode->CreateComponent<CollisionShape>();
+    GetSubsystem<CollisionMeshCache>()->SetTriangleMesh(shape, model);
+
+    // a spawn area spread past the level gets flat ground under it
+    if (density_ > 0.0f)
+    {
+        float size = GetSubsystem<Server>()->GetSpawnSize() + 20.0f;
+        Node* groundNode = scene_->CreateChild("ground", LOCAL);
+        groundNode->SetPosition(Vector3(0.0f, -0.5f, 0.0f));
+        groundNode->CreateComponent<RigidBody>();
+        groundNode->CreateComponent<CollisionShape>()->SetBox(Vector3(size, 1.0f, size));
+    }
+
+    GetSubsystem<Server>()->RegisterClientHashAndScene(Baller::GetTypeStatic(), scene_);
+}
+
+void ReplicationTest::SpawnClients()
+{
+    for (unsigned i = 0; i < numClients_; ++i)
+    {
+        SpawnClient(i);
+    }
+
+    // its ball comes to rest and stays there for the late joiner
+    clients_[0]->SetIdle(true);
+}
+
+Bot* ReplicationTest::SpawnClient(unsigned index)
+{
+    SharedPtr<Context> context = Bot::CreateContext(context_, compactTransforms_);
+    SharedPtr<Bot> bot(new Bot(context, index));
+
+    clientContexts_.Push(context);
+    clients_.Push(bot);
+
+    bot->Connect("localhost", port_);
+    return bot;
+}
+
+void ReplicationTest::SampleClients()
+{
+    float bytesIn = 0.0f;
+    float bytesOut = 0.0f;
+
+    for (unsigned i = 0; i < clients_.Size(); ++i)
+    {
+        Bot* bot = clients_[i];
+        bytesIn += bot->GetBytesInPerSec();
+        bytesOut += bot->GetBytesOutPerSec();
+
+        // node IDs are the same on both sides of the replication
+        Node* clientNode = bot->GetScene()->GetNode(bot->GetClientObjectID());
+        Node* serverNode = scene_->GetNode(bot->GetClientObjectID());
+        if (clientNode && serverNode)
+        {
+            float divergence = (clientNode->GetWorldPosition() - serverNode->GetWorldPosition()).Length();
+            divergenceSum_ += divergence;
+            divergenceMax_ = Max(divergenceMax_, divergence);
+            ++numDivergenceSamples_;
+        }
+    }
+
+    bytesInSum_ += bytesIn / clients_.Size();
+    bytesOutSum_ += bytesOut / clients_.Size();
+    ++numBandwidthSamples_;
+
+    // objects in each connection's interest area, every object without a radius
+    const Vector<ClientSlot>& slots = GetSubsystem<Server>()->GetClients();
+    float relevant = 0.0f;
+    for (unsigned i = 0; i < slots.Size(); ++i)
+    {
+        relevant += interestRadius_ > 0.0f ? slots[i].numRelevant_ : slots.Size();
+    }
+    relevantSum_ += slots.Size() ? relevant / slots.Size() : 0.0f;
+}
+
+bool ReplicationTest::SampleLateJoin()
+{
+    // the late joiner only has the value the server last wrote for a ball at rest, nothing newer is coming
+    Bot* idleBot = clients_[0];
+    Node* clientNode = lateClient_->GetScene()->GetNode(idleBot->GetClientObjectID());
+    Node* serverNode = scene_->GetNode(idleBot->GetClientObjectID());
+    if (!clientNode || !serverNode)
+        return false;
+
+    AddResult("late_join_divergence", (clientNode->GetWorldPosition() - serverNode->GetWorldPosition()).Length(), "m");
+    return true;
+}
+
+void ReplicationTest::CollectResults()
+{
+    float joinSum = 0.0f;
+    float joinMax = 0.0f;
+    for (unsigned i = 0; i < numClients_; ++i)
+    {
+        joinSum += clients_[i]->GetClientObjectTime();
+        joinMax = Max(joinMax, clients_[i]->GetClientObjectTime());
+    }
+
+    const LatencyHistogram& ticks = GetSubsystem<TickProfiler>()->GetHistogram(TICKSTAGE_TICK);
+
+    AddResult("join_avg", joinSum / numClients_, "ms");
+    AddResult("join_max", joinMax, "ms");
+    AddResult("tick_p50", ticks.GetPercentile(0.5f), "ms");
+    AddResult("tick_p99", ticks.GetPercentile(0.99f), "ms");
+    AddResult("client_in", numBandwidthSamples_ ? bytesInSum_ / numBandwidthSamples_ : 0.0f, "B/s");
+    AddResult("client_out", numBandwidthSamples_ ? bytesOutSum_ / numBandwidthSamples_ : 0.0f, "B/s");
+    AddResult("relevant_avg", numBandwidthSamples_ ? relevantSum_ / numBandwidthSamples_ : 0.0f, "nodes");
+    AddResult("divergence_avg", numDivergenceSamples_ ? divergenceSum_ / numDivergenceSamples_ : 0.0f, "m");
+    AddResult("divergence_max", divergenceMax_, "m");
+}
+
+void ReplicationTest::AddResult(const String &name, float value, const String &unit)
+{
+    Metric metric;
+    metric.name_ = name;
+    metric.value_ = value;
+    metric.unit_ = unit;
+    metric.baseline_ = 0.0f;
+    metric.limit_ = 0.0f;
+    results_.Push(metric);
+
+    String line = ToString("repl.%s = %.3f %s", name.CString(), value, unit.CString());
+    PrintLine(line);
+    URHO3D_LOGINFO(line);
+}
+
+bool ReplicationTest::CheckBaseline()
+{
+    XMLFile* baseline = GetSubsystem<ResourceCache>()->GetResource<XMLFile>(baselineFile_);
+    if (!baseline)
+    {
+        URHO3D_LOGERRORF("replication baseline %s not found", baselineFile_.CString());
+        return false;
+    }
+
+    // numbers from a different setup can't be compared
+    XMLElement root = baseline->GetRoot();
+    if (root.GetUInt("clients") != numClients_ || root.GetBool("compact") != compactTransforms_ ||
+        root.GetFloat("interest") != interestRadius_ || root.GetFloat("density") != density_)
+    {
+        URHO3D_LOGERRORF("replication baseline %s is for %u clients%s, interest %.1f and density %.1f, rerun with the same "
+            "options or -updatebaseline", baselineFile_.CString(), root.GetUInt("clients"),
+            root.GetBool("compact") ? " with -compact" : "", root.GetFloat("interest"), root.GetFloat("density"));
+        return false;
+    }
+
+    bool passed = true;
+    float rootTolerance = root.HasAttribute("tolerance") ? root.GetFloat("tolerance") : 0.25f;
+
+    for (unsigned i = 0; i < results_.Size(); ++i)
+    {
+        Metric& metric = results_[i];
+
+        XMLElement entry = root.GetChild("metric");
+        while (entry && entry.GetAttribute("name") != metric.name_)
+            entry = entry.GetNext("metric");
+
+        if (!entry)
+        {
+            URHO3D_LOGWARNINGF("repl.%s has no baseline", metric.name_.CString());
+            continue;
+        }
+
+        // a metric may allow more noise than the rest, the command line overrides both
+        float tolerance = entry.HasAttribute("tolerance") ? entry.GetFloat("tolerance") : rootTolerance;
+        if (tolerance_ >= 0.0f)
+            tolerance = tolerance_;
+
+        metric.baseline_ = entry.GetFloat("value");
+        metric.limit_ = metric.baseline_ * (1.0f + tolerance);
+
+        if (metric.value_ > metric.limit_)
+        {
+            String line = ToString("REGRESSION repl.%s = %.3f %s, baseline %.3f, limit %.3f", metric.name_.CString(),
+                metric.value_, metric.unit_.CString(), metric.baseline_, metric.limit_);
+            PrintLine(line, true);
+            URHO3D_LOGERROR(line);
+            passed = false;
+        }
+    }
+
+    return passed;
+}
+
+bool ReplicationTest::SaveBaseline() const
+{
+    SharedPtr<XMLFile> baseline(new XMLFile(context_));
+    XMLElement root = baseline->CreateRoot("baseline");
+    root.SetUInt("clients", numClients_);
+    root.SetBool("compact", compactTransforms_);
+    root.SetFloat("interest", interestRadius_);
+    root.SetFloat("density", density_);
+    root.SetFloat("tolerance", tolerance_ >= 0.0f ? tolerance_ : 0.25f);
+
+    for (unsigned i = 0; i < results_.Size(); ++i)
+    {
+        XMLElement entry = root.CreateChild("metric");
+        entry.SetAttribute("name", results_[i].name_);
+        entry.SetFloat("value", results_[i].value_);
+        entry.SetAttribute("unit", results_[i].unit_);
+    }
+
+    // overwrite the baseline where the cache found it, or create it under Data
+    String fileName = GetSubsystem<ResourceCache>()->GetResourceFileName(baselineFile_);
+    if (fileName.Empty())
+    {
+        fileName = GetSubsystem<FileSystem>()->GetProgramDir() + "Data/" + baselineFile_;
+    }
+
+    File file(context_, fileName, FILE_WRITE);
+    if (!file.IsOpen() || !baseline->Save(file))
+    {
+        URHO3D_LOGERRORF("could not write replication baseline %s", fileName.CString());
+        return false;
+    }
+
+    URHO3D_LOGINFOF("replication baseline written to %s", fileName.CString());
+    return true;
+}
+
+bool ReplicationTest::WriteResults(bool passed) const
+{
+    File file(context_, outputFile_, FILE_WRITE);
+    if (!file.IsOpen())
+    {
+        URHO3D_LOGERRORF("could not write replication results %s", outputFile_.CString());
+        return false;
+    }
+
+    String line = ToString("{\"clients\":%u,\"compact\":%s,\"interest\":%.1f,\"density\":%.1f,\"tick_rate\":%d,"
+        "\"duration\":%.1f,\"passed\":%s,\"metrics\":{", numClients_, compactTransforms_ ? "true" : "false",
+        interestRadius_, density_, tickRate_, duration_, passed ? "true" : "false");
+
+    for (unsigned i = 0; i < results_.Size(); ++i)
+    {
+        const Metric& metric = results_[i];
+        line += ToString("%s\"%s\":{\"value\":%.3f,\"unit\":\"%s\"", i ? "," : "", metric.name_.CString(), metric.value_,
+            metric.unit_.CString());
+
+        if (metric.limit_ > 0.0f)
+        {
+            line += ToString(",\"baseline\":%.3f,\"limit\":%.3f", metric.baseline_, metric.limit_);
+        }
+
+        line += "}";
+    }
+
+    line += "}}";
+    file.WriteLine(line);
+
+    return true;
+}
+
+void ReplicationTest::SetPhase(TestPhase phase)
+{
+    phase_ = phase;
+    phaseTime_ = 0.0f;
+}
+
+void ReplicationTest::Finish(bool passed)
+{
+    SetPhase(PHASE_DONE);
+
+    if (!passed)
+    {
+        exitCode_ = EXIT_FAILURE;
+    }
+
+    engine_->Exit();
+}
+
+void ReplicationTest::HandlePreloadFinished(StringHash eventType, VariantMap& eventData)
+{
+    GetSubsystem<MaterialPalette>()->Load();
+
+    CreateScene();
+
+    SubscribeToEvent(E_PHYSICSPRESTEP, URHO3D_HANDLER(ReplicationTest, HandlePhysicsPreStep));
+
+    Server* server = GetSubsystem<Server>();
+    // room for the late joiner
+    server->SetMaxClients(numClients_ + 1);
+
+    if (!server->StartServer(port_))
+    {
+        URHO3D_LOGERRORF("replication test could not start a server on port %u", (unsigned)port_);
+        Finish(false);
+        return;
+    }
+
+    SpawnClients();
+    SetPhase(PHASE_JOINING);
+}
+
+void ReplicationTest::HandlePhysicsPreStep(StringHash eventType, VariantMap& eventData)
+{
+    // server applies the controls received on each client connection, there are no local controls
+    GetSubsystem<Server>()->UpdatePhysicsPreStep(Controls());
+}
+
+void ReplicationTest::HandleUpdate(StringHash eventType, VariantMap& eventData)
+{
+    using namespace Update;
+    float timeStep = eventData[P_TIMESTEP].GetFloat();
+
+    phaseTime_ += timeStep;
+
+    for (unsigned i = 0; i < clients_.Size(); ++i)
+    {
+        clients_[i]->Update(timeStep);
+    }
+
+    switch (phase_)
+    {
+    case PHASE_LOADING:
+        if (phaseTime_ > joinTimeout_)
+        {
+            URHO3D_LOGERROR("replication test timed out loading resources");
+            Finish(false);
+        }
+        break;
+
+    case PHASE_JOINING:
+        {
+            unsigned numJoined = 0;
+            for (unsigned i = 0; i < clients_.Size(); ++i)
+            {
+                if (clients_[i]->HasClientObject())
+                    ++numJoined;
+            }
+
+            if (numJoined == clients_.Size())
+            {
+                SetPhase(PHASE_WARMUP);
+            }
+            else if (phaseTime_ > joinTimeout_)
+            {
+                URHO3D_LOGERRORF("replication test timed out joining, %u of %u clients have their ball", numJoined,
+                    clients_.Size());
+                Finish(false);
+            }
+        }
+        break;
+
+    case PHASE_WARMUP:
+        // joins and the first snapshots are out of the way, time the steady state only
+        if (phaseTime_ >= warmup_)
+        {
+            GetSubsystem<TickProfiler>()->ResetHistograms();
+            SetPhase(PHASE_MEASURING);
+        }
+        break;
+
+    case PHASE_MEASURING:
+        SampleClients();
+
+        if (phaseTime_ >= duration_)
+        {
+            CollectResults();
+
+            lateClient_ = SpawnClient(numClients_);
+            SetPhase(PHASE_LATEJOIN);
+        }
+        break;
+
+    case PHASE_LATEJOIN:
+        if (lateClient_->HasClientObject())
+        {
+            lateJoinTime_ = Max(lateJoinTime_, 0.0f) + timeStep;
+        }
+
+        // its first snapshots are in by then, and would have been followed by updates if the ball were moving
+        if (lateJoinTime_ >= LATE_JOIN_SETTLE)
+        {
+            if (!SampleLateJoin())
+            {
+                URHO3D_LOGERROR("replication test late joiner never saw the idle ball");
+                Finish(false);
+                break;
+            }
+
+            bool passed = true;
+            if (!baselineFile_.Empty())
+            {
+                passed = updateBaseline_ ? SaveBaseline() : CheckBaseline();
+            }
+
+            WriteResults(passed);
+            PrintLine(passed ? "replication test passed" : "replication test FAILED", !passed);
+            Finish(passed);
+        }
+        else if (phaseTime_ > joinTimeout_)
+        {
+            URHO3D_LOGERROR("replication test timed out waiting for the late joiner");
+            Finish(false);
+        }
+        break;
+
+    default:
+        break;
+    }
+}
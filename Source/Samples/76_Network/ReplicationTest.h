@@ -0,0 +1,150 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include <Urho3D/Engine/Application.h>
+
+#include "Bot.h"
+
+namespace Urho3D
+{
+class Scene;
+}
+
+using namespace Urho3D;
+//=============================================================================
+//=============================================================================
+class ResourcePreloader;
+
+//=============================================================================
+//=============================================================================
+/// Headless replication benchmark and regression test. Hosts the server and M bots in one process, connected over
+/// loopback and driven by the bots' scripted input, and measures join time, server tick time, bytes per client per
+/// second and how far each bot's copy of its own ball is from the server's. The first bot stays idle, and at the end one
+/// more bot joins and measures how far its copy of that resting ball is from the server's. Results are printed and
+/// written to a json file. -interest and -density spread the balls over an area that grows with the client count, to
+/// check that bytes per client stay flat with an interest radius. With a baseline, any metric over its baseline value
+/// by more than the tolerance fails the run with a non-zero exit code; -updatebaseline rewrites the baseline from this
+/// run instead.
+/// usage: 76_Network_ReplTest [-clients <n>] [-warmup <s>] [-duration <s>] [-jointimeout <s>] [-port <n>] [-compact]
+///        [-dormancy <s>] [-interest <radius>] [-density <m2 per client>] [-output <file.json>]
+///        [-baseline <resource.xml>] [-tolerance <fraction>] [-updatebaseline]
+class ReplicationTest : public Application
+{
+    URHO3D_OBJECT(ReplicationTest, Application);
+
+public:
+    ReplicationTest(Context* context);
+
+    virtual void Setup();
+    virtual void Start();
+    virtual void Stop();
+
+protected:
+    enum TestPhase
+    {
+        PHASE_LOADING,
+        PHASE_JOINING,
+        PHASE_WARMUP,
+        PHASE_MEASURING,
+        PHASE_LATEJOIN,
+        PHASE_DONE
+    };
+
+    /// One measured value, lower is better for all of them.
+    struct Metric
+    {
+        String name_;
+        float value_;
+        String unit_;
+        /// Baseline value and the value that fails the run, 0 without a baseline.
+        float baseline_;
+        float limit_;
+    };
+
+    void ParseArguments();
+    void CreateServerSubsystem();
+    void CreateScene();
+    void SpawnClients();
+    Bot* SpawnClient(unsigned index);
+    void SampleClients();
+    /// Late joiner: measure its copy of the idle first bot's ball, returns false if it could not see it.
+    bool SampleLateJoin();
+    void CollectResults();
+    void AddResult(const String &name, float value, const String &unit);
+    /// Compare the results to the baseline, returns false if any regressed.
+    bool CheckBaseline();
+    bool SaveBaseline() const;
+    bool WriteResults(bool passed) const;
+    void SetPhase(TestPhase phase);
+    void Finish(bool passed);
+
+    void HandlePreloadFinished(StringHash eventType, VariantMap& eventData);
+    void HandlePhysicsPreStep(StringHash eventType, VariantMap& eventData);
+    void HandleUpdate(StringHash eventType, VariantMap& eventData);
+
+protected:
+    SharedPtr<Scene> scene_;
+    SharedPtr<ResourcePreloader> preloader_;
+    Vector<SharedPtr<Context> > clientContexts_;
+    Vector<SharedPtr<Bot> > clients_;
+    SharedPtr<Bot> lateClient_;
+    Vector<Metric> results_;
+
+    TestPhase phase_;
+    float phaseTime_;
+
+    unsigned short port_;
+    int tickRate_;
+    unsigned numClients_;
+    float warmup_;
+    float duration_;
+    /// Seconds allowed for loading, and then for every client to get its ball.
+    float joinTimeout_;
+    bool compactTransforms_;
+    /// Server dormancy time, lets the idle bot's ball fall asleep before the late joiner comes in.
+    float dormancyTime_;
+    /// Server interest radius, 0 replicates everything.
+    float interestRadius_;
+    /// Spawn area per client in square meters, 0 uses the server's default spawn area for any count.
+    float density_;
+
+    String outputFile_;
+    /// Baseline resource, empty only reports.
+    String baselineFile_;
+    /// Allowed regression as a fraction of the baseline, below 0 uses the baseline file's.
+    float tolerance_;
+    bool updateBaseline_;
+
+    /// Accumulated while measuring, per frame.
+    float bytesInSum_;
+    float bytesOutSum_;
+    unsigned numBandwidthSamples_;
+    float relevantSum_;
+    float divergenceSum_;
+    float divergenceMax_;
+    unsigned numDivergenceSamples_;
+    /// Seconds since the late joiner got its ball, below 0 before.
+    float lateJoinTime_;
+};
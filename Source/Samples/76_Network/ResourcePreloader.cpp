@@ -0,0 +1,109 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <Urho3D/Core/CoreEvents.h>
+#include <Urho3D/Graphics/Graphics.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/Resource/ResourceCache.h>
+#include <Urho3D/Resource/ResourceEvents.h>
+#include <Urho3D/Resource/XMLFile.h>
+
+#include "ResourcePreloader.h"
+
+#include <Urho3D/DebugNew.h>
+//=============================================================================
+//=============================================================================
+ResourcePreloader::ResourcePreloader(Context* context)
+    : Object(context)
+    , numResources_(0)
+    , numFailed_(0)
+    , finished_(false)
+{
+    SubscribeToEvent(E_RESOURCEBACKGROUNDLOADED, URHO3D_HANDLER(ResourcePreloader, HandleResourceBackgroundLoaded));
+    SubscribeToEvent(E_BEGINFRAME, URHO3D_HANDLER(ResourcePreloader, HandleBeginFrame));
+}
+
+ResourcePreloader::~ResourcePreloader()
+{
+}
+
+bool ResourcePreloader::LoadManifest(const String &manifestName)
+{
+    // the manifest itself is tiny, read it in place
+    XMLFile* manifest = GetSubsystem<ResourceCache>()->GetResource<XMLFile>(manifestName);
+
+    if (!manifest)
+    {
+        URHO3D_LOGERRORF("preload manifest %s not found", manifestName.CString());
+        return false;
+    }
+
+    bool headless = GetSubsystem<Graphics>() == NULL;
+
+    for (XMLElement resource = manifest->GetRoot().GetChild("resource"); resource; resource = resource.GetNext("resource"))
+    {
+        if (headless && resource.GetBool("client"))
+            continue;
+
+        Add(StringHash(resource.GetAttribute("type")), resource.GetAttribute("name"));
+    }
+
+    return true;
+}
+
+void ResourcePreloader::Add(StringHash type, const String &name)
+{
+    // already cached or queued is fine, the finish check only looks at the cache's queue
+    GetSubsystem<ResourceCache>()->BackgroundLoadResource(type, name);
+    ++numResources_;
+}
+
+void ResourcePreloader::HandleResourceBackgroundLoaded(StringHash eventType, VariantMap& eventData)
+{
+    using namespace ResourceBackgroundLoaded;
+
+    if (!eventData[P_SUCCESS].GetBool())
+    {
+        ++numFailed_;
+    }
+}
+
+void ResourcePreloader::HandleBeginFrame(StringHash eventType, VariantMap& eventData)
+{
+    // also covers builds without threading, where the loads already completed synchronously
+    if (finished_ || GetSubsystem<ResourceCache>()->GetNumBackgroundLoadResources() > 0)
+        return;
+
+    finished_ = true;
+    UnsubscribeFromAllEvents();
+
+    float elapsed = timer_.GetUSec(false) / 1000.0f;
+    URHO3D_LOGINFOF("preloaded %u resources in %.1fms, %u failed", numResources_, elapsed, numFailed_);
+
+    using namespace PreloadFinished;
+    VariantMap& newEventData = GetEventDataMap();
+    newEventData[P_NUMRESOURCES] = numResources_;
+    newEventData[P_NUMFAILED] = numFailed_;
+    newEventData[P_ELAPSED] = elapsed;
+    SendEvent(E_PRELOADFINISHED, newEventData);
+}
@@ -0,0 +1,69 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Core/Timer.h>
+
+using namespace Urho3D;
+//=============================================================================
+//=============================================================================
+URHO3D_EVENT(E_PRELOADFINISHED, PreloadFinished)
+{
+    URHO3D_PARAM(P_NUMRESOURCES, NumResources); // unsigned
+    URHO3D_PARAM(P_NUMFAILED, NumFailed);       // unsigned
+    URHO3D_PARAM(P_ELAPSED, Elapsed);           // float, ms
+}
+
+//=============================================================================
+//=============================================================================
+/// Loads a manifest of resources on the engine's background resource threads, so the main thread keeps running while
+/// the level, ball and UI resources stream in. Sends E_PRELOADFINISHED once the cache has them all.
+class ResourcePreloader : public Object
+{
+    URHO3D_OBJECT(ResourcePreloader, Object);
+
+public:
+    ResourcePreloader(Context* context);
+    virtual ~ResourcePreloader();
+
+    /// Queue every resource listed in an xml manifest, entries marked client="true" are skipped headless. Returns
+    /// false if the manifest can't be read.
+    bool LoadManifest(const String &manifestName);
+    /// Queue one resource.
+    void Add(StringHash type, const String &name);
+
+    bool IsFinished() const { return finished_; }
+    unsigned GetNumResources() const { return numResources_; }
+
+protected:
+    void HandleResourceBackgroundLoaded(StringHash eventType, VariantMap& eventData);
+    void HandleBeginFrame(StringHash eventType, VariantMap& eventData);
+
+protected:
+    HiresTimer timer_;
+    unsigned numResources_;
+    unsigned numFailed_;
+    bool finished_;
+};
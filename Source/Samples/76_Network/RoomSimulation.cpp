@@ -0,0 +1,254 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/Physics/CollisionShape.h>
+#include <Urho3D/Physics/PhysicsWorld.h>
+#include <Urho3D/Physics/RigidBody.h>
+#include <Urho3D/Scene/Scene.h>
+
+#include <Bullet/BulletDynamics/Dynamics/btDiscreteDynamicsWorld.h>
+
+#include "RoomSimulation.h"
+#include "Baller.h"
+#include "BallerSystem.h"
+#include "CollisionMeshCache.h"
+#include "TickProfiler.h"
+
+#include <Urho3D/DebugNew.h>
+//=============================================================================
+//=============================================================================
+static const unsigned NEW_SNAPSHOT = 0x4;
+static const unsigned SNAPSHOT_INDEX_MASK = 0x3;
+
+//=============================================================================
+//=============================================================================
+RoomSimulation::RoomSimulation(Context* context)
+    : context_(context)
+    , physicsWorld_(NULL)
+    , ballerSystem_(NULL)
+    , backIndex_(0)
+    , frontIndex_(1)
+    , spareIndex_(2)
+    , tick_(0)
+    , profiler_(NULL)
+    , profileSource_(0)
+{
+}
+
+RoomSimulation::~RoomSimulation()
+{
+}
+
+void RoomSimulation::CreateScene(Scene* replicatedScene, int fps)
+{
+    // the main thread must never update this scene, nor send its physics events
+    scene_ = new Scene(context_);
+    scene_->SetUpdateEnabled(false);
+    physicsWorld_ = scene_->CreateComponent<PhysicsWorld>(LOCAL);
+    physicsWorld_->SetFps(fps);
+    physicsWorld_->SetUpdateEnabled(false);
+    physicsWorld_->GetWorld()->setInternalTickCallback(NULL, NULL, true);
+    physicsWorld_->GetWorld()->setInternalTickCallback(NULL, NULL, false);
+    ballerSystem_ = scene_->CreateComponent<BallerSystem>(LOCAL);
+
+    // rebuild the static collision, the level is a local node in the replicated scene. Only the transform, body and
+    // shapes are copied, and triangle meshes go through the cache so a room doesn't cook the level again
+    CollisionMeshCache* meshCache = context_->GetSubsystem<CollisionMeshCache>();
+    const Vector<SharedPtr<Node> >& children = replicatedScene->GetChildren();
+    for (unsigned i = 0; i < children.Size(); ++i)
+    {
+        Node* child = children[i];
+        if (child->GetID() < FIRST_LOCAL_ID || !child->GetComponent<CollisionShape>())
+            continue;
+
+        Node* node = scene_->CreateChild(child->GetName(), LOCAL);
+        node->SetWorldTransform(child->GetWorldPosition(), child->GetWorldRotation(), child->GetWorldScale());
+
+        RigidBody* body = node->CreateComponent<RigidBody>(LOCAL);
+        RigidBody* sourceBody = child->GetComponent<RigidBody>();
+        if (sourceBody)
+        {
+            body->SetCollisionLayerAndMask(sourceBody->GetCollisionLayer(), sourceBody->GetCollisionMask());
+            body->SetFriction(sourceBody->GetFriction());
+            body->SetRestitution(sourceBody->GetRestitution());
+        }
+
+        PODVector<CollisionShape*> shapes;
+        child->GetComponents<CollisionShape>(shapes);
+        for (unsigned j = 0; j < shapes.Size(); ++j)
+        {
+            CollisionShape* source = shapes[j];
+            CollisionShape* shape = node->CreateComponent<CollisionShape>(LOCAL);
+
+            if (source->GetShapeType() == SHAPE_TRIANGLEMESH && source->GetModel() && meshCache)
+            {
+                meshCache->SetTriangleMesh(shape, source->GetModel());
+            }
+            else
+            {
+                shape->SetShapeType(source->GetShapeType());
+                shape->SetModel(source->GetModel());
+                shape->SetSize(source->GetSize());
+            }
+
+            shape->SetPosition(source->GetPosition());
+            shape->SetRotation(source->GetRotation());
+        }
+    }
+}
+
+void RoomSimulation::AddClient(Node* replicatedNode, const String &userName, int colorIdx, float dormancyTime)
+{
+    MutexLock lock(mutex_);
+
+    Node* clientNode = scene_->CreateChild("client", LOCAL);
+    clientNode->SetWorldPosition(replicatedNode->GetWorldPosition());
+    clientNode->SetWorldRotation(replicatedNode->GetWorldRotation());
+
+    // no scene update to run its delayed start, set it up now
+    Baller* baller = clientNode->CreateComponent<Baller>(LOCAL);
+    baller->SetClientInfo(userName, colorIdx);
+    baller->SetDormancyTime(dormancyTime);
+    baller->SetSimulationOnly(true);
+    baller->Create();
+
+    clients_[replicatedNode->GetID()].baller_ = baller;
+}
+
+void RoomSimulation::RemoveClient(unsigned nodeId)
+{
+    MutexLock lock(mutex_);
+
+    HashMap<unsigned, SimClient>::Iterator it = clients_.Find(nodeId);
+    if (it != clients_.End())
+    {
+        it->second_.baller_->GetNode()->Remove();
+        clients_.Erase(it);
+    }
+}
+
+const SimSnapshot* RoomSimulation::AcquireSnapshot()
+{
+    if (!(spareIndex_.load() & NEW_SNAPSHOT))
+        return NULL;
+
+    frontIndex_ = spareIndex_.exchange(frontIndex_) & SNAPSHOT_INDEX_MASK;
+    return &snapshots_[frontIndex_];
+}
+
+LatencyHistogram RoomSimulation::GetTickTime() const
+{
+    MutexLock lock(mutex_);
+    return tickTime_;
+}
+
+void RoomSimulation::Tick(float timeStep)
+{
+    MutexLock lock(mutex_);
+    HiresTimer tickTimer;
+    TickSample sample;
+    if (profiler_)
+    {
+        sample.startUSec_ = profiler_->GetUSec();
+    }
+
+    // inputs queued since the last tick. A stalled tick pops several for a client, apply them as one so a press in
+    // an earlier input isn't lost: buttons from all of them, the newest yaw
+    SimInput input;
+    while (inputs_.Pop(input))
+    {
+        HashMap<unsigned, SimClient>::Iterator it = clients_.Find(input.nodeId_);
+        if (it != clients_.End())
+        {
+            SimClient& client = it->second_;
+            client.buttons_ = client.hasInput_ ? client.buttons_ | input.buttons_ : input.buttons_;
+            client.yaw_ = input.yaw_;
+            client.hasInput_ = true;
+            if (input.seq_)
+                client.inputSeq_ = input.seq_;
+        }
+    }
+
+    for (HashMap<unsigned, SimClient>::Iterator it = clients_.Begin(); it != clients_.End(); ++it)
+    {
+        SimClient& client = it->second_;
+        if (client.hasInput_)
+        {
+            Controls controls;
+            controls.buttons_ = client.buttons_;
+            controls.yaw_ = client.yaw_;
+            client.baller_->SetControls(controls);
+            client.hasInput_ = false;
+        }
+    }
+    long long inputUSec = tickTimer.GetUSec(false);
+
+    // what the pre-step event would do, then one fixed step. Bodies write their transforms back to the private nodes
+    ballerSystem_->Update(timeStep);
+    long long ballersUSec = tickTimer.GetUSec(false);
+    physicsWorld_->GetWorld()->stepSimulation(timeStep, 0);
+    long long physicsUSec = tickTimer.GetUSec(false);
+
+    Publish();
+
+    long long totalUSec = tickTimer.GetUSec(false);
+    tickTime_.Record(totalUSec / 1000.0f);
+
+    if (profiler_)
+    {
+        sample.tick_ = tick_;
+        sample.source_ = profileSource_;
+        sample.stageUSec_[TICKSTAGE_TICK] = (unsigned)totalUSec;
+        sample.stageUSec_[TICKSTAGE_INPUT] = (unsigned)inputUSec;
+        sample.stageUSec_[TICKSTAGE_BALLERS] = (unsigned)(ballersUSec - inputUSec);
+        sample.stageUSec_[TICKSTAGE_PHYSICS] = (unsigned)(physicsUSec - ballersUSec);
+        sample.stageMask_ = (1u << TICKSTAGE_TICK) | (1u << TICKSTAGE_INPUT) | (1u << TICKSTAGE_BALLERS) |
+            (1u << TICKSTAGE_PHYSICS);
+        profiler_->Submit(sample);
+    }
+}
+
+void RoomSimulation::Publish()
+{
+    SimSnapshot& snapshot = snapshots_[backIndex_];
+    snapshot.tick_ = ++tick_;
+    snapshot.entries_.Resize(clients_.Size());
+
+    unsigned index = 0;
+    for (HashMap<unsigned, SimClient>::ConstIterator it = clients_.Begin(); it != clients_.End(); ++it, ++index)
+    {
+        const Baller* baller = it->second_.baller_;
+        SimEntry& entry = snapshot.entries_[index];
+        entry.nodeId_ = it->first_;
+        baller->GetTransformState(entry.state_);
+        entry.colorIdx_ = baller->GetColorIdx();
+        entry.dormant_ = baller->IsDormant();
+        entry.inputSeq_ = it->second_.inputSeq_;
+    }
+
+    // hand the written buffer over as the latest, take the spare to write the next tick into
+    backIndex_ = spareIndex_.exchange(backIndex_ | NEW_SNAPSHOT) & SNAPSHOT_INDEX_MASK;
+}
@@ -0,0 +1,172 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Container/Ptr.h>
+#include <Urho3D/Container/RefCounted.h>
+#include <Urho3D/Core/Mutex.h>
+
+#include <atomic>
+
+#include "TransformCodec.h"
+#include "LatencyHistogram.h"
+#include "SpscQueue.h"
+
+namespace Urho3D
+{
+class Context;
+class Node;
+class Scene;
+class PhysicsWorld;
+}
+
+using namespace Urho3D;
+//=============================================================================
+//=============================================================================
+class Baller;
+class BallerSystem;
+class TickProfiler;
+
+//=============================================================================
+//=============================================================================
+/// One client's controls on their way to a room's simulation, keyed by the replicated node id.
+struct SimInput
+{
+    unsigned nodeId_;
+    unsigned buttons_;
+    float yaw_;
+    /// Client input sequence number, acknowledged once a tick has applied it.
+    unsigned seq_;
+};
+
+/// One client object's state as of a simulation tick.
+struct SimEntry
+{
+    unsigned nodeId_;
+    TransformState state_;
+    int colorIdx_;
+    bool dormant_;
+    /// Newest client input sequence number applied by this tick, 0 if none yet.
+    unsigned inputSeq_;
+};
+
+/// Everything a room's simulation publishes per tick.
+struct SimSnapshot
+{
+    SimSnapshot()
+        : tick_(0)
+    {
+    }
+
+    unsigned tick_;
+    PODVector<SimEntry> entries_;
+};
+
+/// A simulated client object and the inputs a tick applies to it.
+struct SimClient
+{
+    SimClient()
+        : baller_(NULL)
+        , buttons_(0)
+        , yaw_(0.0f)
+        , inputSeq_(0)
+        , hasInput_(false)
+    {
+    }
+
+    Baller* baller_;
+    /// Inputs popped this tick, merged.
+    unsigned buttons_;
+    float yaw_;
+    unsigned inputSeq_;
+    bool hasInput_;
+};
+
+//=============================================================================
+//=============================================================================
+/// Server: the authoritative client object simulation of one room, in a private scene that mirrors the room's
+/// replicated scene's static collision. Ticked by a SimulationThread; the main thread never touches the private scene,
+/// except for joins and leaves, which wait for the current tick to finish.
+///
+/// Per tick data crosses threads without locks: inputs through a single producer ring, states through a swap of three
+/// snapshot buffers, one being written, one being read and one spare holding the latest published tick, so neither
+/// side ever waits on the other. A tick drives the BallerSystem and steps Bullet directly, engine events can only be
+/// sent from the main thread.
+class RoomSimulation : public RefCounted
+{
+public:
+    RoomSimulation(Context* context);
+    virtual ~RoomSimulation();
+
+    /// Main thread, before ticking starts: build the private scene, copying the static collision of the replicated
+    /// scene's local nodes.
+    void CreateScene(Scene* replicatedScene, int fps);
+    /// Main thread: add a simulated twin of a replicated client object, at its current position.
+    void AddClient(Node* replicatedNode, const String &userName, int colorIdx, float dormancyTime);
+    void RemoveClient(unsigned nodeId);
+    /// Main thread: queue controls for the next tick, returns false if the ring is full.
+    bool PushInput(const SimInput& input) { return inputs_.Push(input); }
+    /// Main thread: return the latest published snapshot, or null if nothing new was published since the last call.
+    const SimSnapshot* AcquireSnapshot();
+
+    /// Simulation thread: apply queued inputs, step once and publish.
+    void Tick(float timeStep);
+    /// Before ticking starts: submit each tick's stage timings to a profiler under a source id.
+    void SetProfiler(TickProfiler* profiler, unsigned source)
+    {
+        profiler_ = profiler;
+        profileSource_ = source;
+    }
+
+    /// Tick durations.
+    LatencyHistogram GetTickTime() const;
+
+    static const unsigned INPUT_CAPACITY = 4096;
+
+private:
+    void Publish();
+
+    Context* context_;
+    SharedPtr<Scene> scene_;
+    PhysicsWorld* physicsWorld_;
+    BallerSystem* ballerSystem_;
+    HashMap<unsigned, SimClient> clients_;
+
+    SpscQueue<SimInput, INPUT_CAPACITY> inputs_;
+
+    SimSnapshot snapshots_[3];
+    /// Owned by the simulation thread and the main thread respectively.
+    unsigned backIndex_;
+    unsigned frontIndex_;
+    /// Spare buffer index, with NEW_SNAPSHOT set while it holds a tick the main thread has not taken yet.
+    std::atomic<unsigned> spareIndex_;
+    unsigned tick_;
+
+    /// Held by the simulation thread for the length of a tick, and by the main thread for joins and leaves.
+    mutable Mutex mutex_;
+    LatencyHistogram tickTime_;
+    TickProfiler* profiler_;
+    unsigned profileSource_;
+};
@@ -21,6 +21,7 @@
 //
 
 #include <Urho3D/Core/CoreEvents.h>
+#include <Urho3D/Core/ProcessUtils.h>
 #include <Urho3D/Engine/Engine.h>
 #include <Urho3D/Graphics/Camera.h>
 #include <Urho3D/Graphics/Graphics.h>
@@ -55,6 +56,12 @@
 #include "Server.h"
 #include "ClientObj.h"
 #include "Baller.h"
+#include "BallerSystem.h"
+#include "MaterialPalette.h"
+#include "CollisionMeshCache.h"
+#include "ResourcePreloader.h"
+#include "SnapshotInterpolator.h"
+#include "NetConditioner.h"
 
 #include <Urho3D/DebugNew.h>
 //=============================================================================
@@ -84,11 +91,19 @@ void SceneReplication::Start()
 {
     Sample::Start();
 
-    // rand seed
-    SetRandomSeed(Time::GetSystemTime());
-
     CreateServerSubsystem();
 
+    // stream the level, ball and UI resources in on the background threads, the scene and UI are built once they're
+    // in so nothing loads on the main thread when the first players join
+    preloader_ = new ResourcePreloader(context_);
+    SubscribeToEvent(preloader_, E_PRELOADFINISHED, URHO3D_HANDLER(SceneReplication, HandlePreloadFinished));
+    preloader_->LoadManifest("NetDemo/Preload.xml");
+}
+
+void SceneReplication::HandlePreloadFinished(StringHash eventType, VariantMap& eventData)
+{
+    GetSubsystem<MaterialPalette>()->Load();
+
     CreateScene();
 
     CreateUI();
@@ -100,15 +115,66 @@ void SceneReplication::Start()
     ChangeDebugHudText();
 
     Sample::InitMouseMode(MM_RELATIVE);
+
+    SubscribeToEvent(E_ENDFRAME, URHO3D_HANDLER(SceneReplication, HandleFirstFrame));
+}
+
+void SceneReplication::HandleFirstFrame(StringHash eventType, VariantMap& eventData)
+{
+    URHO3D_LOGINFOF("first interactive frame %.1fms after startup", startupTimer_.GetUSec(false) / 1000.0f);
+
+    UnsubscribeFromEvent(E_ENDFRAME);
 }
 
 void SceneReplication::CreateServerSubsystem()
 {
-    context_->RegisterSubsystem(new Server(context_));
+    Server* server = new Server(context_);
+    context_->RegisterSubsystem(server);
+
+    // compact transform stream, the server must be started with the same option
+    NetConditions netConditions;
+    const Vector<String>& arguments = GetArguments();
+    for (unsigned i = 0; i < arguments.Size(); ++i)
+    {
+        String argument = arguments[i].ToLower();
+
+        if (argument == "-compact")
+        {
+            server->SetCompactTransforms(true);
+        }
+        else if (argument == "-predict")
+        {
+            server->SetClientPrediction(true);
+        }
+        else if (argument == "-interpolate" && i + 1 < arguments.Size())
+        {
+            server->SetClientInterpolation(Max(ToFloat(arguments[++i]), 0.0f));
+        }
+        else if (i + 1 < arguments.Size() && NetConditioner::ParseArgument(argument, arguments[i + 1], netConditions))
+        {
+            ++i;
+        }
+    }
+
+    // rand seed, or a -netseed to repeat the link impairments
+    NetConditioner::SeedRandom(netConditions.seed_);
+
+    // simulated link for whichever side this instance ends up, client or server
+    NetConditioner* conditioner = new NetConditioner(context_);
+    context_->RegisterSubsystem(conditioner);
+    conditioner->SetConditions(netConditions);
+
+    // ball materials, resolved once preloading is done and before any client object is created
+    context_->RegisterSubsystem(new MaterialPalette(context_));
+
+    // level collision cooked once per process
+    context_->RegisterSubsystem(new CollisionMeshCache(context_));
 
     // register client objs
     ClientObj::RegisterObject(context_);
     Baller::RegisterObject(context_);
+    BallerSystem::RegisterObject(context_);
+    SnapshotInterpolator::RegisterObject(context_);
 }
 
 void SceneReplication::CreateScene()
@@ -127,6 +193,7 @@ void SceneReplication::CreateScene()
     PhysicsWorld *physicsWorld = scene_->CreateComponent<PhysicsWorld>(LOCAL);
     DebugRenderer *dbgRenderer = scene_->CreateComponent<DebugRenderer>(LOCAL);
     physicsWorld->SetDebugRenderer(dbgRenderer);
+    scene_->CreateComponent<BallerSystem>(LOCAL);
 
     // All static scene content and the camera are also created as local, so that they are unaffected by scene replication and are
     // not removed from the client upon connection. Create a Zone component first for ambient lighting & fog control.
@@ -157,7 +224,7 @@ void SceneReplication::CreateScene()
     floor->SetCastShadows(true);
     floorNode->CreateComponent<RigidBody>();
     CollisionShape* shape = floorNode->CreateComponent<CollisionShape>();
-    shape->SetTriangleMesh(model);
+    GetSubsystem<CollisionMeshCache>()->SetTriangleMesh(shape, model);
 
     // cam
     cameraNode_ = scene_->CreateChild("Camera", LOCAL);
@@ -174,7 +241,8 @@ void SceneReplication::CreateAdminPlayer()
     ClientObj *clientObj = (ClientObj*)clientNode->CreateComponent(Baller::GetTypeStatic());
 
     // set identity
-    clientObj->SetClientInfo("ADMIN", 99);
+    clientObj->SetClientInfo("ADMIN", MaterialPalette::ADMIN_COLOR_INDEX);
+    GetSubsystem<Server>()->SetHostObject(clientNode);
     clientObjectID_ = clientNode->GetID();
     isServer_ = true;
 }
@@ -359,11 +427,28 @@ void SceneReplication::MoveCamera()
     instructionsText_->SetVisible(showInstructions);
 }
 
+void SceneReplication::UpdatePredictionText()
+{
+    ClientObj* clientObj = GetSubsystem<Server>()->GetClientObject();
+
+    if (clientObj && clientObj->IsPredicted())
+    {
+        instructionsText_->SetText(ToString("WASD to move, RMB to rotate view, T to swap mat\n"
+            "prediction error=%.3fm max=%.3fm corrections=%u",
+            clientObj->GetPredictionError(), clientObj->GetMaxPredictionError(), clientObj->GetNumCorrections()));
+    }
+}
+
 void SceneReplication::HandlePostUpdate(StringHash eventType, VariantMap& eventData)
 {
     // We only rotate the camera according to mouse movement since last frame, so do not need the time step
     MoveCamera();
 
+    if (!isServer_)
+    {
+        UpdatePredictionText();
+    }
+
     if (drawDebug_)
     {
         scene_->GetComponent<PhysicsWorld>()->DrawDebugGeometry(true);
@@ -464,11 +549,10 @@ void SceneReplication::HandleConnectionStatus(StringHash eventType, VariantMap&
     using namespace ServerStatus;
     StringHash msg = eventData[P_STATUS].GetStringHash();
 
+    // the server has already dropped the replicated nodes, the local world, collision and camera stay for a reconnect
     if (msg == E_SERVERDISCONNECTED)
     {
-        scene_->RemoveAllChildren();
-        CreateScene();
-        SetupViewport();
+        clientObjectID_ = 0;
 
         URHO3D_LOGINFO("server connection lost");
     }
@@ -24,6 +24,8 @@
 
 #include "Sample.h"
 
+#include <Urho3D/Core/Timer.h>
+
 namespace Urho3D
 {
 
@@ -35,6 +37,10 @@ class UIElement;
 
 }
 
+//=============================================================================
+//=============================================================================
+class ResourcePreloader;
+
 //=============================================================================
 //=============================================================================
 class SceneReplication : public Sample
@@ -68,6 +74,7 @@ private:
     Button* CreateButton(const String& text, int width);
     void UpdateButtons();
     void MoveCamera();
+    void UpdatePredictionText();
     void HandlePhysicsPreStep(StringHash eventType, VariantMap& eventData);
     void HandlePostUpdate(StringHash eventType, VariantMap& eventData);
     void HandleConnect(StringHash eventType, VariantMap& eventData);
@@ -75,8 +82,13 @@ private:
     void HandleStartServer(StringHash eventType, VariantMap& eventData);
     void HandleConnectionStatus(StringHash eventType, VariantMap& eventData);
     void HandleClientObjectID(StringHash eventType, VariantMap& eventData);
+    void HandlePreloadFinished(StringHash eventType, VariantMap& eventData);
+    void HandleFirstFrame(StringHash eventType, VariantMap& eventData);
 
     HashMap<Connection*, WeakPtr<Node> > serverObjects_;
+    SharedPtr<ResourcePreloader> preloader_;
+    /// Runs from construction, for startup timings.
+    HiresTimer startupTimer_;
     SharedPtr<UIElement> buttonContainer_;
     SharedPtr<LineEdit> textEdit_;
     SharedPtr<Button> connectButton_;
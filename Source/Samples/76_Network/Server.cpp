@@ -22,44 +22,138 @@
 
 #include <Urho3D/Core/CoreEvents.h>
 #include <Urho3D/Scene/Scene.h>
+#include <Urho3D/Scene/SceneEvents.h>
 #include <Urho3D/Network/Connection.h>
 #include <Urho3D/Network/Network.h>
 #include <Urho3D/Network/NetworkEvents.h>
+#include <Urho3D/Network/NetworkPriority.h>
 #include <Urho3D/Physics/CollisionShape.h>
 #include <Urho3D/Physics/PhysicsEvents.h>
+#include <Urho3D/Physics/PhysicsWorld.h>
 #include <Urho3D/Resource/ResourceCache.h>
 #include <Urho3D/Graphics/Material.h>
 #include <Urho3D/Graphics/Model.h>
 #include <Urho3D/Graphics/StaticModel.h>
 #include <Urho3D/IO/FileSystem.h>
+#include <Urho3D/IO/MemoryBuffer.h>
 #include <Urho3D/IO/Log.h>
 
+#include <kNet/MessageConnection.h>
+
 #include "Server.h"
 #include "ClientObj.h"
+#include "Baller.h"
+#include "NetStats.h"
+#include "SnapshotInterpolator.h"
+#include "RoomSimulation.h"
+#include "SimulationThread.h"
+#include "TickProfiler.h"
 
 #include <Urho3D/DebugNew.h>
+//=============================================================================
+//=============================================================================
+// client object update priority, the engine sends a node when its accumulated priority reaches 100
+static const float UPDATE_PRIORITY = 1000.0f;
+// a connection parked this far away gets zero priority for every node it doesn't own
+static const float SKIP_DISTANCE = 1.0e6f;
+static const Vector3 SKIP_POSITION(SKIP_DISTANCE, SKIP_DISTANCE, SKIP_DISTANCE);
+
+// distance between rooms in the shared interest grid
+static const float ROOM_SPACING = 1.0e5f;
+
+// client object collision sphere, 1 unit across
+static const float CLIENT_OBJECT_RADIUS = 0.5f;
+// lag compensation history is sized for this many client objects per room at most
+static const unsigned MAX_LAG_ENTITIES = 1024;
+
+// a joining client's initial snapshot is through once its outbound queue is down to the regular update traffic
+static const unsigned SNAPSHOT_DRAINED_QUEUE = 8;
+
 //=============================================================================
 //=============================================================================
 Server::Server(Context* context)
     : Object(context)
     , clientObjectID_(0)
+    , maxClients_(M_MAX_UNSIGNED)
+    , clientPoolSize_(0)
+    , maxStreamingClients_(0)
+    , threadedSimulation_(false)
+    , numSimulationThreads_(1)
+    , lastTickUSec_(-1)
+    , tickPeriodUSec_(0)
+    , lagCompensationTime_(0.0f)
+    , maxInterpolationDelay_(0.25f)
+    , dormancyTime_(0.0f)
+    , spawnSize_(40.0f)
+    , nextRecordId_(1)
+    , interestRadius_(0.0f)
+    , minUpdateInterval_(1)
+    , maxUpdateInterval_(1)
+    , clientInterestRadius_(0.0f)
+    , clientPrediction_(false)
+    , inputSeq_(1)
+    , clientInterpolationDelay_(0.0f)
+    , compactTransforms_(false)
 {
     SubscribeToEvents();
 }
 
 Server::~Server()
 {
+    StopSimulation();
 }
 
 void Server::RegisterClientHashAndScene(StringHash clientHash, Scene *scene)
 {
     clientHash_ = clientHash;
     scene_ = scene;
+
+    // the registered scene is the default room
+    rooms_.Clear();
+    Room room;
+    room.name_ = "0";
+    room.scene_ = scene;
+    rooms_.Push(room);
+
+    // client: replicated objects are given an interpolator as they arrive
+    SubscribeToEvent(scene_, E_COMPONENTADDED, URHO3D_HANDLER(Server, HandleComponentAdded));
 }
 
 bool Server::StartServer(unsigned short port)
 {
-    return GetSubsystem<Network>()->StartServer(port);
+    // set up before anyone can join, so the pre-created objects are never replicated
+    if (clientPoolSize_ > clientObjPool_.GetNumFree())
+    {
+        clientObjPool_.Reserve(scene_, clientHash_, clientPoolSize_ - clientObjPool_.GetNumFree());
+    }
+
+    PhysicsWorld* physicsWorld = scene_->GetComponent<PhysicsWorld>();
+    tickPeriodUSec_ = physicsWorld ? 1000000LL / physicsWorld->GetFps() : 0;
+    lastTickUSec_ = -1;
+    tickJitter_.Reset();
+
+    if (threadedSimulation_)
+    {
+        StartSimulation();
+    }
+
+    Network* network = GetSubsystem<Network>();
+
+    // one frame per network update over the rewind window, plus one to interpolate from
+    if (lagCompensationTime_ > 0.0f)
+    {
+        unsigned numFrames = (unsigned)CeilToInt(lagCompensationTime_ * network->GetUpdateFps()) + 1;
+        unsigned maxEntities = Min(maxClients_, MAX_LAG_ENTITIES);
+
+        for (unsigned i = 0; i < rooms_.Size(); ++i)
+        {
+            rooms_[i].history_.SetCapacity(numFrames, maxEntities);
+        }
+        URHO3D_LOGINFOF("lag compensation: %u updates of %u objects per room, %u KB", numFrames, maxEntities,
+            rooms_[0].history_.GetMemoryUse() / 1024);
+    }
+
+    return network->StartServer(port);
 }
 
 bool Server::Connect(const String &addressRequet, unsigned short port, const VariantMap& identity)
@@ -74,8 +168,16 @@ bool Server::Connect(const String &addressRequet, unsigned short port, const Var
 
     // Connect to server, specify scene to use as a client for replication
     clientObjectID_ = 0; // Reset own object ID from possible previous connection
+    inputSender_.Reset();
+
+    // the server rewinds to what we see when resolving hits against other objects
+    VariantMap clientIdentity(identity);
+    if (clientInterpolationDelay_ > 0.0f && compactTransforms_)
+    {
+        clientIdentity["InterpolationDelay"] = clientInterpolationDelay_;
+    }
 
-    return network->Connect(address, port, scene_, identity);
+    return network->Connect(address, port, scene_, clientIdentity);
 }
 
 void Server::Disconnect()
@@ -95,27 +197,56 @@ void Server::Disconnect()
     else if (network->IsServerRunning())
     {
         network->StopServer();
-        scene_->Clear(true, false);
+        StopInputRecording();
+        StopSimulation();
+        for (unsigned i = 0; i < rooms_.Size(); ++i)
+        {
+            rooms_[i].scene_->Clear(true, false);
+            rooms_[i].history_.Clear();
+        }
+        clients_.Clear();
+        connectionSlots_.Clear();
+        pendingJoins_.Clear();
+        clientObjPool_.Clear();
     }
 }
 
-Node* Server::CreateClientObject(Connection *connection)
+Node* Server::CreateClientObject(Connection *connection, unsigned room)
 {
-    Node* clientNode = scene_->CreateChild("client");
-    clientNode->SetPosition(Vector3(Random(40.0f) - 20.0f, 5.0f, Random(40.0f) - 20.0f));
+    Node* clientNode = clientObjPool_.Acquire(rooms_[room].scene_, clientHash_);
+    clientNode->SetPosition(Vector3(Random(spawnSize_) - spawnSize_ * 0.5f, 5.0f, Random(spawnSize_) - spawnSize_ * 0.5f));
 
-    ClientObj *clientObj = (ClientObj*)clientNode->CreateComponent(clientHash_);
+    ClientObj *clientObj = clientNode->GetDerivedComponent<ClientObj>();
 
     // set identity
     if (connection)
     {
+        clientNode->SetOwner(connection);
+
+        // With an interest radius, priority falls off with distance from the connection's own object and reaches
+        // zero at the radius, so the engine stops sending updates for nodes out of range. With an adaptive update rate
+        // the falloff only needs to reach zero at the skip distance
+        if (interestRadius_ > 0.0f || maxUpdateInterval_ > 1)
+        {
+            float falloffDistance = interestRadius_ > 0.0f ? interestRadius_ : SKIP_DISTANCE * 0.1f;
+            NetworkPriority* priority = clientNode->GetOrCreateComponent<NetworkPriority>(LOCAL);
+            priority->SetBasePriority(UPDATE_PRIORITY);
+            priority->SetDistanceFactor(UPDATE_PRIORITY / falloffDistance);
+            priority->SetMinPriority(0.0f);
+            priority->SetAlwaysUpdateOwner(true);
+        }
+
         String name = connection->identity_["UserName"].GetString();
         int colorIdx = connection->identity_["ColorIdx"].GetInt();
         clientObj->SetClientInfo(name, colorIdx);
+        clientObj->SetDormancyTime(dormancyTime_);
 
         URHO3D_LOGINFOF("client identity name=%s", name.CString());
     }
 
+    // a recycled object is set up again for its new client, a new one would otherwise wait for its delayed start
+    clientObj->Create();
+
     return clientNode;
 }
 
@@ -134,48 +265,104 @@ void Server::SubscribeToEvents()
     // Additional events that we might be interested in
     SubscribeToEvent(E_CLIENTIDENTITY, URHO3D_HANDLER(Server, HandleClientIdentity));
     SubscribeToEvent(E_CLIENTSCENELOADED, URHO3D_HANDLER(Server, HandleClientSceneLoaded));
+    SubscribeToEvent(E_NETWORKUPDATE, URHO3D_HANDLER(Server, HandleNetworkUpdate));
     SubscribeToEvent(E_NETWORKUPDATESENT, URHO3D_HANDLER(Server, HandleNetworkUpdateSent));
+    SubscribeToEvent(E_NETWORKMESSAGE, URHO3D_HANDLER(Server, HandleNetworkMessage));
 }
 
 void Server::UpdatePhysicsPreStep(const Controls &controls)
 {
-    // This function is different on the client and server. The client collects controls (WASD controls + yaw angle)
-    // and sets them to its server connection object, so that they will be sent to the server automatically at a
-    // fixed rate, by default 30 FPS. The server will actually apply the controls (authoritative simulation.)
+    // This function is different on the client and server. The client samples controls (WASD controls + yaw angle)
+    // into its input message, which goes out with every network update, by default 30 FPS. The server will actually
+    // apply the inputs (authoritative simulation.)
     Network* network = GetSubsystem<Network>();
     Connection* serverConnection = network->GetServerConnection();
 
     // Client: collect controls
     if (serverConnection)
     {
-        serverConnection->SetControls(controls);
+        inputSender_.Sample(controls.buttons_, controls.yaw_);
+
+        // prediction: move our own object with the same input, material swaps are left to the server
+        if (clientPrediction_ && compactTransforms_)
+        {
+            ClientObj* clientObj = GetClientObject();
+
+            if (clientObj)
+            {
+                Controls predictControls(controls);
+                predictControls.buttons_ &= ~SWAP_MAT;
+                clientObj->SetControls(predictControls);
+            }
+        }
     }
     // Server: apply controls to client objects
     else if (network->IsServerRunning())
     {
-        const Vector<SharedPtr<Connection> >& connections = network->GetClientConnections();
+        NetStatsScope scope(GetSubsystem<NetStats>(), STAGE_INPUT);
+        TickProfileScope profileScope(GetSubsystem<TickProfiler>(), TICKSTAGE_INPUT);
 
-        for (unsigned i = 0; i < connections.Size(); ++i)
+        // physics steps are run from the frame loop, several back to back after a slow frame
+        long long now = tickClock_.GetUSec(false);
+        if (lastTickUSec_ >= 0)
         {
-            Connection* connection = connections[i];
-            const Controls& controls = connection->GetControls();
+            tickJitter_.Record(Abs(now - lastTickUSec_ - tickPeriodUSec_) / 1000.0f);
+        }
+        lastTickUSec_ = now;
 
-            // Get the object this connection is controlling
-            Node* clientNode = serverObjects_[connection];
+        if (inputLog_.IsOpen())
+        {
+            inputLog_.BeginTick(clients_.Size());
+        }
 
-            if (!clientNode)
-                continue;
+        for (unsigned i = 0; i < clients_.Size(); ++i)
+        {
+            ClientSlot& client = clients_[i];
+            const InputFrame& input = client.input_.Next();
 
-            ClientObj* clientObj = clientNode->GetDerivedComponent<ClientObj>();
+            Controls controls;
+            controls.buttons_ = input.buttons_;
+            controls.yaw_ = DequantizeYaw(input.yaw_);
+            client.clientObj_->SetControls(controls);
 
-            if (clientObj)
+            if (inputLog_.IsOpen())
             {
-                clientObj->SetControls(controls);
+                inputLog_.WriteControls(client.recordId_, controls);
+            }
+
+            // acks only matter to predicting clients, which need the compact stream
+            if (compactTransforms_ && input.seq_)
+            {
+                client.clientObj_->SetInputAck(input.seq_);
             }
         }
     }
 }
 
+void Server::HandleComponentAdded(StringHash eventType, VariantMap& eventData)
+{
+    using namespace ComponentAdded;
+
+    if (clientInterpolationDelay_ <= 0.0f || !compactTransforms_ || !GetSubsystem<Network>()->GetServerConnection())
+        return;
+
+    Component* component = static_cast<Component*>(eventData[P_COMPONENT].GetPtr());
+    Node* node = static_cast<Node*>(eventData[P_NODE].GetPtr());
+
+    // our own object is predicted, not interpolated
+    if (!component->IsInstanceOf<ClientObj>() || node->GetID() == clientObjectID_)
+        return;
+
+    SnapshotInterpolator* interpolator = node->CreateComponent<SnapshotInterpolator>(LOCAL);
+    interpolator->SetDelay(clientInterpolationDelay_);
+}
+
+ClientObj* Server::GetClientObject() const
+{
+    Node* clientNode = clientObjectID_ ? scene_->GetNode(clientObjectID_) : NULL;
+    return clientNode ? clientNode->GetDerivedComponent<ClientObj>() : NULL;
+}
+
 void Server::SendStatusMsg(StringHash msg)
 {
     using namespace ServerStatus;
@@ -186,30 +373,754 @@ void Server::SendStatusMsg(StringHash msg)
     SendEvent(E_SERVERSTATUS, newEventData);
 }
 
+void Server::SendRemoteEvent(Connection *connection, StringHash eventType, const VariantMap& eventData)
+{
+    connection->SendRemoteEvent(eventType, true, eventData);
+
+    NetStats* netStats = GetSubsystem<NetStats>();
+    if (netStats)
+    {
+        netStats->AddRemoteEvent(connection);
+    }
+}
+
+void Server::SendClientInput()
+{
+    Connection* serverConnection = GetSubsystem<Network>()->GetServerConnection();
+
+    // the server has nothing to apply input to until our object is spawned in the loaded scene
+    if (!serverConnection->IsSceneLoaded())
+        return;
+
+    // unreliable, every message repeats the last few inputs, so a lost one is made up by the next
+    inputMsg_.Clear();
+    inputSender_.Write(inputSeq_, inputMsg_);
+    serverConnection->SendMessage(MSG_CLIENTINPUT, false, false, inputMsg_);
+}
+
 void Server::HandleClientIdentity(StringHash eventType, VariantMap& eventData)
 {
 	using namespace ClientIdentity;
     URHO3D_LOGINFO("HandleClientIdentity");
 
-    // When a client connects, assign to scene to begin scene replication
     Connection* newConnection = static_cast<Connection*>(eventData[P_CONNECTION].GetPtr());
-    newConnection->SetScene(scene_);
 
-    // Then create a controllable object for that client
-    Node* clientObject = CreateClientObject(newConnection);
-    serverObjects_[newConnection] = clientObject;
+    // Refuse the connection if the server is full, counting clients still joining
+    if (clients_.Size() + pendingJoins_.Size() >= maxClients_)
+    {
+        URHO3D_LOGINFOF("client refused, server full at %u clients", maxClients_);
+        eventData[P_ALLOW] = false;
+        return;
+    }
 
-    // Finally send the object's node ID using a remote event
-    VariantMap remoteEventData;
-    remoteEventData[ClientObjectID::P_ID] = clientObject->GetID();
-    newConnection->SendRemoteEvent(E_CLIENTOBJECTID, true, remoteEventData);
+    // Queue the client, it is given its room's scene when a streaming slot frees up
+    PendingJoin join;
+    join.connection_ = newConnection;
+    join.room_ = SelectRoom(newConnection);
+    join.startUSec_ = joinClock_.GetUSec(false);
+    join.stageUSec_ = join.startUSec_;
+    pendingJoins_.Push(join);
+
+    UpdateJoins();
 }
 
 void Server::HandleClientSceneLoaded(StringHash eventType, VariantMap& eventData)
 {
 	using namespace ClientSceneLoaded;
     URHO3D_LOGINFO("HandleClientSceneLoaded");
-    // some process yet tbd
+
+    Connection* connection = static_cast<Connection*>(eventData[P_CONNECTION].GetPtr());
+
+    for (unsigned i = 0; i < pendingJoins_.Size(); ++i)
+    {
+        PendingJoin& join = pendingJoins_[i];
+        if (join.connection_ != connection || join.stage_ != JOIN_STREAMING)
+            continue;
+
+        long long now = joinClock_.GetUSec(false);
+        joinHistograms_[JOINHIST_STREAMING].Record((now - join.stageUSec_) / 1000.0f);
+        join.stage_ = JOIN_SNAPSHOT;
+        join.stageUSec_ = now;
+
+        // the scene is loaded, the object is replicated along with the rest of the initial snapshot
+        SpawnClient(connection, join.room_);
+        break;
+    }
+}
+
+void Server::SpawnClient(Connection *connection, unsigned room)
+{
+    // create a controllable object for the client
+    Node* clientObject = CreateClientObject(connection, room);
+    unsigned slot = AddClientSlot(connection, clientObject, room);
+
+    if (inputLog_.IsOpen())
+    {
+        ClientObj* clientObj = clients_[slot].clientObj_;
+        inputLog_.WriteJoin(clients_[slot].recordId_, clientObj->GetUserName(), clientObj->GetColorIdx(),
+            clientObject->GetPosition());
+    }
+
+    // then send the object's node ID using a remote event
+    VariantMap remoteEventData;
+    remoteEventData[ClientObjectID::P_ID] = clientObject->GetID();
+    remoteEventData[ClientObjectID::P_INTERESTRADIUS] = interestRadius_;
+    SendRemoteEvent(connection, E_CLIENTOBJECTID, remoteEventData);
+}
+
+void Server::UpdateJoins()
+{
+    long long now = joinClock_.GetUSec(false);
+    unsigned numStreaming = 0;
+
+    // retire joins whose initial snapshot has gone out, their streaming slot frees up
+    for (unsigned i = 0; i < pendingJoins_.Size();)
+    {
+        PendingJoin& join = pendingJoins_[i];
+
+        if (join.stage_ == JOIN_SNAPSHOT)
+        {
+            kNet::MessageConnection* messageConnection = join.connection_->GetMessageConnection();
+            unsigned sendQueue = messageConnection ? (unsigned)messageConnection->NumOutboundMessagesPending() : 0;
+
+            if (sendQueue <= SNAPSHOT_DRAINED_QUEUE)
+            {
+                joinHistograms_[JOINHIST_SNAPSHOT].Record((now - join.stageUSec_) / 1000.0f);
+                joinHistograms_[JOINHIST_TOTAL].Record((now - join.startUSec_) / 1000.0f);
+                pendingJoins_.Erase(i);
+                continue;
+            }
+        }
+
+        if (join.stage_ != JOIN_QUEUED)
+        {
+            ++numStreaming;
+        }
+        ++i;
+    }
+
+    // admit queued clients in arrival order, assigning the scene begins scene replication
+    for (unsigned i = 0; i < pendingJoins_.Size(); ++i)
+    {
+        if (maxStreamingClients_ && numStreaming >= maxStreamingClients_)
+            break;
+
+        PendingJoin& join = pendingJoins_[i];
+        if (join.stage_ != JOIN_QUEUED)
+            continue;
+
+        joinHistograms_[JOINHIST_QUEUED].Record((now - join.stageUSec_) / 1000.0f);
+        join.stage_ = JOIN_STREAMING;
+        join.stageUSec_ = now;
+        join.connection_->SetScene(rooms_[join.room_].scene_);
+        ++numStreaming;
+    }
+}
+
+void Server::RemovePendingJoin(Connection *connection)
+{
+    for (unsigned i = 0; i < pendingJoins_.Size(); ++i)
+    {
+        if (pendingJoins_[i].connection_ == connection)
+        {
+            pendingJoins_.Erase(i);
+            break;
+        }
+    }
+}
+
+void Server::AddRoom(const String &name, Scene *scene)
+{
+    Room room;
+    room.name_ = name;
+    room.scene_ = scene;
+    rooms_.Push(room);
+}
+
+unsigned Server::GetNumRoomClients(unsigned index) const
+{
+    unsigned count = 0;
+    for (unsigned i = 0; i < clients_.Size(); ++i)
+    {
+        if (clients_[i].room_ == index)
+            ++count;
+    }
+    // clients already spawned are in both
+    for (unsigned i = 0; i < pendingJoins_.Size(); ++i)
+    {
+        if (pendingJoins_[i].room_ == index && pendingJoins_[i].stage_ != JOIN_SNAPSHOT)
+            ++count;
+    }
+    return count;
+}
+
+unsigned Server::SelectRoom(Connection *connection) const
+{
+    const String& name = connection->identity_["Room"].GetString();
+
+    if (!name.Empty())
+    {
+        for (unsigned i = 0; i < rooms_.Size(); ++i)
+        {
+            if (rooms_[i].name_ == name)
+                return i;
+        }
+    }
+
+    // no room asked for, or not hosted here, fill up the least populated one
+    unsigned best = 0;
+    unsigned bestCount = M_MAX_UNSIGNED;
+    for (unsigned i = 0; i < rooms_.Size(); ++i)
+    {
+        unsigned count = GetNumRoomClients(i);
+        if (count < bestCount)
+        {
+            best = i;
+            bestCount = count;
+        }
+    }
+    return best;
+}
+
+LatencyHistogram Server::GetRoomTickTime(unsigned index) const
+{
+    return rooms_[index].simulation_ ? rooms_[index].simulation_->GetTickTime() : LatencyHistogram();
+}
+
+unsigned Server::GetNumQueuedJoins() const
+{
+    unsigned count = 0;
+    for (unsigned i = 0; i < pendingJoins_.Size(); ++i)
+    {
+        if (pendingJoins_[i].stage_ == JOIN_QUEUED)
+            ++count;
+    }
+    return count;
+}
+
+unsigned Server::GetNumStreamingJoins() const
+{
+    return pendingJoins_.Size() - GetNumQueuedJoins();
+}
+
+void Server::SetThreadedSimulation(bool enable, unsigned numThreads)
+{
+    threadedSimulation_ = enable;
+    numSimulationThreads_ = Max(numThreads, 1U);
+}
+
+void Server::StartSimulation()
+{
+    PhysicsWorld* physicsWorld = scene_->GetComponent<PhysicsWorld>();
+    if (!physicsWorld || !simulationThreads_.Empty())
+        return;
+
+    int fps = physicsWorld->GetFps();
+    unsigned numThreads = Min(numSimulationThreads_, rooms_.Size());
+
+    for (unsigned i = 0; i < numThreads; ++i)
+    {
+        simulationThreads_.Push(new SimulationThread(fps));
+    }
+
+    // rooms are the same size to begin with, deal them out evenly
+    for (unsigned i = 0; i < rooms_.Size(); ++i)
+    {
+        Room& room = rooms_[i];
+        room.simulation_ = new RoomSimulation(context_);
+        room.simulation_->CreateScene(room.scene_, fps);
+        room.simulation_->SetProfiler(GetSubsystem<TickProfiler>(), i + 1);
+
+        // the replicated scene only mirrors the simulation from now on
+        room.scene_->GetComponent<PhysicsWorld>()->SetUpdateEnabled(false);
+
+        simulationThreads_[i % numThreads]->AddRoom(room.simulation_);
+    }
+
+    for (unsigned i = 0; i < simulationThreads_.Size(); ++i)
+    {
+        simulationThreads_[i]->Run();
+    }
+    SubscribeToEvent(E_UPDATE, URHO3D_HANDLER(Server, HandleUpdate));
+
+    URHO3D_LOGINFOF("simulating %u rooms on %u threads at %i ticks/sec", rooms_.Size(), numThreads, fps);
+}
+
+void Server::StopSimulation()
+{
+    if (simulationThreads_.Empty())
+        return;
+
+    UnsubscribeFromEvent(E_UPDATE);
+
+    // keep the numbers for after the server stops
+    tickJitter_.Reset();
+    for (unsigned i = 0; i < simulationThreads_.Size(); ++i)
+    {
+        simulationThreads_[i]->Stop();
+        tickJitter_.Merge(simulationThreads_[i]->GetTickJitter());
+        URHO3D_LOGINFOF("simulation thread %u tick time: %s", i, simulationThreads_[i]->GetTickTime().ToString().CString());
+        delete simulationThreads_[i];
+    }
+    simulationThreads_.Clear();
+
+    for (unsigned i = 0; i < rooms_.Size(); ++i)
+    {
+        Room& room = rooms_[i];
+        if (room.simulation_)
+        {
+            URHO3D_LOGINFOF("room %u '%s' tick time: %s", i, room.name_.CString(),
+                room.simulation_->GetTickTime().ToString().CString());
+            room.simulation_.Reset();
+        }
+
+        PhysicsWorld* physicsWorld = room.scene_->GetComponent<PhysicsWorld>();
+        if (physicsWorld)
+        {
+            physicsWorld->SetUpdateEnabled(true);
+        }
+    }
+}
+
+LatencyHistogram Server::GetTickJitter() const
+{
+    if (simulationThreads_.Empty())
+        return tickJitter_;
+
+    LatencyHistogram jitter;
+    for (unsigned i = 0; i < simulationThreads_.Size(); ++i)
+    {
+        jitter.Merge(simulationThreads_[i]->GetTickJitter());
+    }
+    return jitter;
+}
+
+void Server::HandleUpdate(StringHash eventType, VariantMap& eventData)
+{
+    // Inputs received this frame go out to the simulation, and the latest tick it published is mirrored into the
+    // replicated scene before this frame's network update reads it
+    PushSimulationInputs();
+    ApplySimulationSnapshot();
+}
+
+void Server::PushSimulationInputs()
+{
+    NetStatsScope scope(GetSubsystem<NetStats>(), STAGE_INPUT);
+
+    for (unsigned i = 0; i < clients_.Size(); ++i)
+    {
+        ClientSlot& client = clients_[i];
+
+        // the simulation applies the newest input it has at each tick, fold everything received this frame into one
+        // so a press in an earlier input isn't overwritten
+        InputFrame received = client.input_.NextMerged();
+
+        // still holding presses the ring had no room for last frame
+        if (client.inputPending_)
+        {
+            received.buttons_ |= client.pendingInput_.buttons_;
+            client.inputPending_ = false;
+        }
+
+        SimInput input;
+        input.nodeId_ = client.node_->GetID();
+        input.buttons_ = received.buttons_;
+        input.yaw_ = DequantizeYaw(received.yaw_);
+        input.seq_ = received.seq_;
+
+        // a full ring means the simulation thread is stalled, keep the input to merge into the next frame's
+        if (!rooms_[client.room_].simulation_->PushInput(input))
+        {
+            client.pendingInput_ = received;
+            client.inputPending_ = true;
+        }
+    }
+}
+
+void Server::ApplySimulationSnapshot()
+{
+    for (unsigned r = 0; r < rooms_.Size(); ++r)
+    {
+        const SimSnapshot* snapshot = rooms_[r].simulation_->AcquireSnapshot();
+        if (!snapshot)
+            continue;
+
+        Scene* scene = rooms_[r].scene_;
+        for (unsigned i = 0; i < snapshot->entries_.Size(); ++i)
+        {
+            const SimEntry& entry = snapshot->entries_[i];
+            Node* clientNode = scene->GetNode(entry.nodeId_);
+            Baller* baller = clientNode ? clientNode->GetComponent<Baller>() : NULL;
+
+            // a dormant baller's state doesn't change until it wakes, it was mirrored as it fell asleep
+            if (baller && !(entry.dormant_ && baller->IsDormant()))
+            {
+                baller->ApplyTransformState(entry.state_);
+                baller->SetColorIdx(entry.colorIdx_);
+                baller->SetDormant(entry.dormant_);
+            }
+
+            // acknowledge inputs once a tick has applied them, not when they were queued
+            ClientObj* clientObj = clientNode ? clientNode->GetDerivedComponent<ClientObj>() : NULL;
+            if (compactTransforms_ && clientObj && entry.inputSeq_)
+            {
+                clientObj->SetInputAck(entry.inputSeq_);
+            }
+        }
+    }
+}
+
+bool Server::StartInputRecording(const String &fileName)
+{
+    // a log replays into a single scene
+    if (rooms_.Size() > 1)
+    {
+        URHO3D_LOGWARNING("input recording is not supported with more than one room");
+        return false;
+    }
+
+    // threaded inputs go straight to the room's simulation, the log is written from the main thread's tick only
+    if (threadedSimulation_)
+    {
+        URHO3D_LOGWARNING("input recording is not supported with a threaded simulation");
+        return false;
+    }
+
+    PhysicsWorld* physicsWorld = scene_->GetComponent<PhysicsWorld>();
+    if (!physicsWorld)
+        return false;
+
+    if (!inputLog_.Open(context_, fileName, physicsWorld->GetFps()))
+        return false;
+
+    // clients already in are joins as far as the log is concerned
+    for (unsigned i = 0; i < clients_.Size(); ++i)
+    {
+        ClientObj* clientObj = clients_[i].clientObj_;
+        inputLog_.WriteJoin(clients_[i].recordId_, clientObj->GetUserName(), clientObj->GetColorIdx(),
+            clients_[i].node_->GetPosition());
+    }
+
+    URHO3D_LOGINFOF("recording input to %s", fileName.CString());
+    return true;
+}
+
+void Server::StopInputRecording()
+{
+    if (inputLog_.IsOpen())
+    {
+        URHO3D_LOGINFOF("input recording stopped after %u ticks", inputLog_.GetNumTicks());
+        inputLog_.Close();
+    }
+}
+
+void Server::SetCompactTransforms(bool enable)
+{
+    // the engine's attributes can't be put back once removed
+    if (enable && !compactTransforms_)
+    {
+        TransformCodec::RegisterCompactTransforms(context_);
+        compactTransforms_ = true;
+    }
+}
+
+void Server::HandleNetworkUpdate(StringHash eventType, VariantMap& eventData)
+{
+    Network* network = GetSubsystem<Network>();
+
+    // Client: this update's input goes out alongside the engine's own client update
+    if (network->GetServerConnection())
+    {
+        SendClientInput();
+        return;
+    }
+
+    if (!network->IsServerRunning())
+        return;
+
+    if (!pendingJoins_.Empty())
+    {
+        UpdateJoins();
+    }
+
+    if (maxUpdateInterval_ > 1)
+    {
+        UpdateActivity();
+    }
+
+    if (interestRadius_ > 0.0f)
+    {
+        UpdateInterest();
+    }
+
+    if (maxUpdateInterval_ > 1)
+    {
+        UpdateAdaptiveRates();
+    }
+
+    if (compactTransforms_)
+    {
+        UpdateNetTransforms();
+    }
+
+    if (lagCompensationTime_ > 0.0f)
+    {
+        RecordLagHistory();
+    }
+}
+
+void Server::RecordLagHistory()
+{
+    // the states this update sends are what clients will be looking at
+    float time = GetSubsystem<Time>()->GetElapsedTime();
+
+    for (unsigned r = 0; r < rooms_.Size(); ++r)
+    {
+        rooms_[r].history_.BeginFrame(time);
+    }
+
+    for (unsigned i = 0; i < clients_.Size(); ++i)
+    {
+        const ClientSlot& client = clients_[i];
+        if (client.node_)
+        {
+            rooms_[client.room_].history_.AddEntity(client.node_->GetID(), client.node_->GetWorldPosition(),
+                CLIENT_OBJECT_RADIUS);
+        }
+    }
+
+    for (unsigned r = 0; r < rooms_.Size(); ++r)
+    {
+        rooms_[r].history_.EndFrame();
+    }
+}
+
+LagCompensation* Server::RewindForClient(unsigned slot)
+{
+    if (lagCompensationTime_ <= 0.0f || slot >= clients_.Size())
+        return NULL;
+
+    const ClientSlot& client = clients_[slot];
+    LagCompensation& history = rooms_[client.room_].history_;
+
+    // states reach the client half a round trip after they were recorded, and are shown a delay later still. A client
+    // can't reach back past the history by delaying its own packets
+    float rewind = Min(client.connection_->GetRoundTripTime() * 0.5f + client.viewDelay_, lagCompensationTime_);
+    history.Rewind(GetSubsystem<Time>()->GetElapsedTime() - rewind);
+
+    return &history;
+}
+
+void Server::UpdateNetTransforms()
+{
+    float time = GetSubsystem<Time>()->GetElapsedTime();
+
+    for (unsigned i = 0; i < clients_.Size(); ++i)
+    {
+        // a dormant object's state is sent once more as it falls asleep, then not encoded until it wakes. That last write
+        // is a key frame, it stays the attribute value new connections get in their snapshot
+        ClientObj* clientObj = clients_[i].clientObj_;
+        if (clientObj->ConsumeDormancyChanged())
+        {
+            clientObj->UpdateNetTransform(time, clientObj->IsDormant());
+        }
+        else if (!clientObj->IsDormant())
+        {
+            clientObj->UpdateNetTransform(time);
+        }
+    }
+
+    if (hostObject_)
+    {
+        ClientObj* clientObj = hostObject_->GetDerivedComponent<ClientObj>();
+
+        if (clientObj)
+        {
+            clientObj->UpdateNetTransform(time);
+        }
+    }
+}
+
+unsigned Server::GetNumDormantClients() const
+{
+    unsigned numDormant = 0;
+    for (unsigned i = 0; i < clients_.Size(); ++i)
+    {
+        if (clients_[i].clientObj_->IsDormant())
+            ++numDormant;
+    }
+    return numDormant;
+}
+
+void Server::SetUpdateIntervalRange(unsigned minInterval, unsigned maxInterval)
+{
+    minUpdateInterval_ = Max(minInterval, 1U);
+    maxUpdateInterval_ = Max(maxInterval, minUpdateInterval_);
+}
+
+void Server::UpdateActivity()
+{
+    const float MOVE_THRESHOLD = 0.01f;
+    roomMoving_.Resize(rooms_.Size());
+    for (unsigned i = 0; i < roomMoving_.Size(); ++i)
+    {
+        roomMoving_[i] = false;
+    }
+
+    for (unsigned i = 0; i < clients_.Size(); ++i)
+    {
+        ClientSlot& client = clients_[i];
+        Vector3 position = client.node_->GetWorldPosition();
+
+        client.moving_ = (position - client.lastPosition_).LengthSquared() > MOVE_THRESHOLD * MOVE_THRESHOLD;
+        client.lastPosition_ = position;
+        roomMoving_[client.room_] |= client.moving_;
+    }
+
+    // without an interest radius everything in a room is near everyone in it, UpdateInterest narrows this down otherwise
+    for (unsigned i = 0; i < clients_.Size(); ++i)
+    {
+        clients_[i].activityNear_ = roomMoving_[clients_[i].room_];
+    }
+}
+
+unsigned Server::SelectUpdateInterval(const ClientSlot& client) const
+{
+    const float HIGH_RTT = 0.15f;
+    const float VERY_HIGH_RTT = 0.3f;
+    const float HIGH_LOSS = 0.05f;
+    const float VERY_HIGH_LOSS = 0.15f;
+    const unsigned CONGESTED_QUEUE = 64;
+
+    // nothing to show, only the owner's own object (which is always sent) matters
+    if (!client.activityNear_)
+        return maxUpdateInterval_;
+
+    unsigned interval = minUpdateInterval_;
+
+    // a slow link can't use updates faster than it acks them
+    if (client.roundTripTime_ > VERY_HIGH_RTT)
+        interval += 2;
+    else if (client.roundTripTime_ > HIGH_RTT)
+        interval += 1;
+
+    // lost updates are superseded by the next one anyway, sending less often lowers the pressure
+    if (client.packetLoss_ > VERY_HIGH_LOSS)
+        interval += 2;
+    else if (client.packetLoss_ > HIGH_LOSS)
+        interval += 1;
+
+    // congested, let the queue drain
+    if (client.sendQueue_ > CONGESTED_QUEUE)
+        interval = maxUpdateInterval_;
+
+    return Min(interval, maxUpdateInterval_);
+}
+
+void Server::UpdateAdaptiveRates()
+{
+    for (unsigned i = 0; i < clients_.Size(); ++i)
+    {
+        ClientSlot& client = clients_[i];
+        Connection* connection = client.connection_;
+        kNet::MessageConnection* messageConnection = connection->GetMessageConnection();
+
+        client.roundTripTime_ = connection->GetRoundTripTime();
+        client.packetLoss_ = messageConnection ? messageConnection->PacketLossRate() : 0.0f;
+        client.sendQueue_ = messageConnection ? (unsigned)messageConnection->NumOutboundMessagesPending() : 0;
+        client.updateInterval_ = SelectUpdateInterval(client);
+
+        // On skipped updates park the connection far away: every node it doesn't own gets zero priority and the
+        // engine skips it. On sends use the real position, which the interest priority falloff is measured from
+        if (++client.updateAcc_ >= client.updateInterval_)
+        {
+            client.updateAcc_ = 0;
+            connection->SetPosition(client.node_->GetWorldPosition());
+        }
+        else
+        {
+            connection->SetPosition(SKIP_POSITION);
+        }
+    }
+}
+
+void Server::UpdateInterest()
+{
+    interestPositions_.Resize(clients_.Size());
+
+    for (unsigned i = 0; i < clients_.Size(); ++i)
+    {
+        // the engine measures node priority distance from the connection's position
+        Vector3 position = clients_[i].node_->GetWorldPosition();
+        clients_[i].connection_->SetPosition(position);
+
+        // rooms share the grid, each is moved far enough along X never to overlap another
+        interestPositions_[i] = position + Vector3(clients_[i].room_ * ROOM_SPACING, 0.0f, 0.0f);
+    }
+
+    interestGrid_.Build(interestPositions_, interestRadius_);
+
+    PODVector<unsigned> relevant;
+    for (unsigned i = 0; i < clients_.Size(); ++i)
+    {
+        relevant.Clear();
+        interestGrid_.Query(interestPositions_[i], interestRadius_, relevant);
+        clients_[i].numRelevant_ = relevant.Size();
+
+        if (maxUpdateInterval_ > 1)
+        {
+            bool activityNear = false;
+            for (unsigned j = 0; j < relevant.Size() && !activityNear; ++j)
+            {
+                activityNear = relevant[j] != i && clients_[relevant[j]].moving_;
+            }
+            clients_[i].activityNear_ = activityNear;
+        }
+    }
+}
+
+void Server::GetRelevantClients(unsigned slot, PODVector<unsigned>& result) const
+{
+    // without a radius every client in the same room is relevant
+    if (interestRadius_ <= 0.0f)
+    {
+        if (slot >= clients_.Size())
+            return;
+
+        for (unsigned i = 0; i < clients_.Size(); ++i)
+        {
+            if (clients_[i].room_ == clients_[slot].room_)
+                result.Push(i);
+        }
+        return;
+    }
+
+    if (slot >= interestPositions_.Size())
+        return;
+
+    interestGrid_.Query(interestPositions_[slot], interestRadius_, result);
+}
+
+void Server::UpdateInterestCulling()
+{
+    Node* clientNode = scene_->GetNode(clientObjectID_);
+
+    if (!clientNode)
+        return;
+
+    // The server stops updating nodes out of range, hide them here rather than show them frozen in place
+    const Vector3 ownPosition = clientNode->GetWorldPosition();
+    const float radiusSquared = clientInterestRadius_ * clientInterestRadius_;
+
+    PODVector<Baller*> ballers;
+    scene_->GetComponents<Baller>(ballers, true);
+
+    for (unsigned i = 0; i < ballers.Size(); ++i)
+    {
+        Vector3 offset = ballers[i]->GetNode()->GetWorldPosition() - ownPosition;
+        offset.y_ = 0.0f;
+        ballers[i]->SetCulled(offset.LengthSquared() > radiusSquared);
+    }
 }
 
 void Server::HandleNetworkUpdateSent(StringHash eventType, VariantMap& eventData)
@@ -222,23 +1133,65 @@ void Server::HandleNetworkUpdateSent(StringHash eventType, VariantMap& eventData
     {
         if (clientObjectID_)
         {
-            Node *clientNode = scene_->GetChild(clientObjectID_);
+            ClientObj *clientObj = GetClientObject();
 
-            if (clientNode)
+            if (clientObj)
             {
-                ClientObj *clientObj = clientNode->GetDerivedComponent<ClientObj>();
+                clientObj->ClearControls();
 
-                if (clientObj)
+                // the input just sent is the one the server will ack, remember where we predicted it put us
+                if (clientPrediction_ && compactTransforms_)
                 {
-                    clientObj->ClearControls();
+                    if (!clientObj->IsPredicted())
+                    {
+                        clientObj->SetPredicted(true);
+                    }
+                    clientObj->RecordPrediction(inputSeq_);
                 }
             }
+
+            if (clientInterestRadius_ > 0.0f)
+            {
+                UpdateInterestCulling();
+            }
         }
+
+        ++inputSeq_;
+    }
+}
+
+void Server::HandleNetworkMessage(StringHash eventType, VariantMap& eventData)
+{
+    using namespace NetworkMessage;
+
+    if (eventData[P_MESSAGEID].GetInt() != MSG_CLIENTINPUT)
+        return;
+
+    Connection* connection = static_cast<Connection*>(eventData[P_CONNECTION].GetPtr());
+
+    // input from a client still joining has no object to drive yet
+    HashMap<Connection*, unsigned>::ConstIterator slot = connectionSlots_.Find(connection);
+    if (slot == connectionSlots_.End())
+        return;
+
+    MemoryBuffer message(eventData[P_DATA].GetBuffer());
+    if (!clients_[slot->second_].input_.Read(message, inputStats_))
+    {
+        URHO3D_LOGWARNINGF("malformed input message from %s", connection->ToString().CString());
     }
 }
 
 void Server::HandleConnectionStatus(StringHash eventType, VariantMap& eventData)
 {
+    // Link lost: remove only the replicated content, same as a requested disconnect. The local nodes & components stay,
+    // so a reconnect only has to stream the replicated scene again
+    if (eventType == E_SERVERDISCONNECTED)
+    {
+        scene_->Clear(true, false);
+        clientObjectID_ = 0;
+        clientInterestRadius_ = 0.0f;
+    }
+
     SendStatusMsg(eventType);
 }
 
@@ -254,15 +1207,76 @@ void Server::HandleClientDisconnected(StringHash eventType, VariantMap& eventDat
     using namespace ClientConnected;
     URHO3D_LOGINFO("HandleClientDisconnected");
 
-    // When a client disconnects, remove the controlled object
+    // When a client disconnects, drop it from the join pipeline and remove the controlled object
     Connection* connection = static_cast<Connection*>(eventData[P_CONNECTION].GetPtr());
-    Node* object = serverObjects_[connection];
-    if (object)
+    RemovePendingJoin(connection);
+    RemoveClientSlot(connection);
+}
+
+unsigned Server::AddClientSlot(Connection *connection, Node *clientNode, unsigned room)
+{
+    unsigned slot = clients_.Size();
+
+    ClientSlot client;
+    client.connection_ = connection;
+    client.node_ = clientNode;
+    client.clientObj_ = clientNode->GetDerivedComponent<ClientObj>();
+    client.clientObj_->SetSlot(slot);
+    client.lastPosition_ = clientNode->GetWorldPosition();
+    client.recordId_ = nextRecordId_++;
+    client.room_ = room;
+    // the delay comes from the client, don't trust it
+    float viewDelay = connection->identity_["InterpolationDelay"].GetFloat();
+    client.viewDelay_ = IsNaN(viewDelay) ? 0.0f :
+        Clamp(viewDelay, 0.0f, Min(maxInterpolationDelay_, lagCompensationTime_));
+    clients_.Push(client);
+    connectionSlots_[connection] = slot;
+
+    RoomSimulation* simulation = rooms_[room].simulation_;
+    if (simulation)
     {
-        object->Remove();
+        simulation->AddClient(clientNode, client.clientObj_->GetUserName(), client.clientObj_->GetColorIdx(),
+            client.clientObj_->GetDormancyTime());
     }
 
-    serverObjects_.Erase(connection);
+    return slot;
+}
+
+void Server::RemoveClientSlot(Connection *connection)
+{
+    // disconnects are rare compared to ticks, a linear search is fine here
+    for (unsigned i = 0; i < clients_.Size(); ++i)
+    {
+        if (clients_[i].connection_ != connection)
+            continue;
+
+        if (inputLog_.IsOpen())
+        {
+            inputLog_.WriteLeave(clients_[i].recordId_);
+        }
+
+        if (clients_[i].node_)
+        {
+            RoomSimulation* simulation = rooms_[clients_[i].room_].simulation_;
+            if (simulation)
+            {
+                simulation->RemoveClient(clients_[i].node_->GetID());
+            }
+            clientObjPool_.Release(clients_[i].node_);
+        }
+
+        // swap-remove, the last entry takes over the freed slot
+        unsigned last = clients_.Size() - 1;
+        if (i != last)
+        {
+            clients_[i] = clients_[last];
+            clients_[i].clientObj_->SetSlot(i);
+            connectionSlots_[clients_[i].connection_] = i;
+        }
+        clients_.Pop();
+        connectionSlots_.Erase(connection);
+        break;
+    }
 }
 
 void Server::HandleClientObjectID(StringHash eventType, VariantMap& eventData)
@@ -270,4 +1284,12 @@ void Server::HandleClientObjectID(StringHash eventType, VariantMap& eventData)
     URHO3D_LOGINFOF("HandleClientObjectID: clientID = %u", clientObjectID_);
 
     clientObjectID_ = eventData[ClientObjectID::P_ID].GetUInt();
+    clientInterestRadius_ = eventData[ClientObjectID::P_INTERESTRADIUS].GetFloat();
+
+    // our object may have been replicated before its id arrived
+    Node* clientNode = scene_->GetNode(clientObjectID_);
+    if (clientNode)
+    {
+        clientNode->RemoveComponent<SnapshotInterpolator>();
+    }
 }
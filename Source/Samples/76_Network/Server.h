@@ -23,18 +23,30 @@
 #pragma once
 
 #include <Urho3D/Core/Object.h>
+#include <Urho3D/Core/Timer.h>
 #include <Urho3D/Input/Controls.h>
+#include <Urho3D/IO/VectorBuffer.h>
+
+#include "InterestGrid.h"
+#include "ClientObjPool.h"
+#include "LatencyHistogram.h"
+#include "InputLog.h"
+#include "InputPacket.h"
+#include "LagCompensation.h"
 
 namespace Urho3D
 {
 class Scene;
 class Connection;
+class Node;
 }
 
 using namespace Urho3D;
 //=============================================================================
 //=============================================================================
 class ClientObj;
+class RoomSimulation;
+class SimulationThread;
 
 //=============================================================================
 //=============================================================================
@@ -51,8 +63,113 @@ URHO3D_EVENT(E_SERVERSTATUS, ServerStatus)
 URHO3D_EVENT(E_CLIENTOBJECTID, ClientObjectID)
 {
 	URHO3D_PARAM(P_ID, ID);         // unsigned
+	URHO3D_PARAM(P_INTERESTRADIUS, InterestRadius); // float, 0 when every node is replicated
 }
 
+//=============================================================================
+//=============================================================================
+/// Connected client entry. Entries are kept contiguous and indexed by slot id so the per-tick input dispatch is a
+/// linear scan with no hashing or component search.
+struct ClientSlot
+{
+    ClientSlot()
+        : connection_(NULL)
+        , clientObj_(NULL)
+        , numRelevant_(0)
+        , lastPosition_(Vector3::ZERO)
+        , moving_(false)
+        , activityNear_(true)
+        , roundTripTime_(0.0f)
+        , packetLoss_(0.0f)
+        , sendQueue_(0)
+        , updateInterval_(1)
+        , updateAcc_(0)
+        , recordId_(0)
+        , room_(0)
+        , viewDelay_(0.0f)
+        , inputPending_(false)
+    {
+    }
+
+    Connection* connection_;
+    WeakPtr<Node> node_;
+    ClientObj* clientObj_;
+    /// Number of client objects within the interest radius at the last network update.
+    unsigned numRelevant_;
+
+    /// Adaptive update rate: whether the object moved, and whether anything near it did, since the last update.
+    Vector3 lastPosition_;
+    bool moving_;
+    bool activityNear_;
+    /// Link quality sampled at the last network update, rtt in seconds, loss 0-1.
+    float roundTripTime_;
+    float packetLoss_;
+    unsigned sendQueue_;
+    /// Send every updateInterval_ network updates.
+    unsigned updateInterval_;
+    unsigned updateAcc_;
+    /// Client id in the input log.
+    unsigned recordId_;
+    /// Index of the room the client plays in.
+    unsigned room_;
+    /// Inputs received from the client, applied one per tick.
+    InputReceiver input_;
+    /// How far in the past the client shows other objects, seconds, from its identity clamped to the server's maximum.
+    float viewDelay_;
+    /// Threaded simulation: merged input the room's ring had no room for, retried with the next frame's.
+    InputFrame pendingInput_;
+    bool inputPending_;
+};
+
+/// Join pipeline stages. A validated identity is queued, admitted to stream the scene when a streaming slot is free,
+/// spawned once the client has loaded the scene, and keeps its slot until its initial snapshot has drained.
+enum JoinStage
+{
+    JOIN_QUEUED = 0,
+    JOIN_STREAMING,
+    JOIN_SNAPSHOT,
+};
+
+/// Join latency histograms, per stage and end to end.
+enum JoinHistogram
+{
+    JOINHIST_QUEUED = 0,
+    JOINHIST_STREAMING,
+    JOINHIST_SNAPSHOT,
+    JOINHIST_TOTAL,
+    MAX_JOINHIST
+};
+
+/// Client that has been accepted but has not finished joining.
+struct PendingJoin
+{
+    PendingJoin()
+        : connection_(NULL)
+        , stage_(JOIN_QUEUED)
+        , room_(0)
+        , startUSec_(0)
+        , stageUSec_(0)
+    {
+    }
+
+    Connection* connection_;
+    JoinStage stage_;
+    unsigned room_;
+    /// Join clock times at identity and at entering the current stage.
+    long long startUSec_;
+    long long stageUSec_;
+};
+
+/// An independent match: its own replicated scene, and with the threaded simulation, its own simulation.
+struct Room
+{
+    String name_;
+    SharedPtr<Scene> scene_;
+    SharedPtr<RoomSimulation> simulation_;
+    /// Client object states of recent network updates, for lag compensated queries.
+    LagCompensation history_;
+};
+
 //=============================================================================
 //=============================================================================
 class Server : public Object
@@ -67,13 +184,113 @@ public:
     bool StartServer(unsigned short port);
     bool Connect(const String &address, unsigned short port, const VariantMap& identity = Variant::emptyVariantMap);
     void Disconnect();
+    /// Pre-create this many client objects when the server starts, and recycle client objects across joins.
+    void SetClientPoolSize(unsigned size) { clientPoolSize_ = size; }
+    const ClientObjPool& GetClientObjPool() const { return clientObjPool_; }
+    void SetMaxClients(unsigned maxClients) { maxClients_ = maxClients; }
+    unsigned GetMaxClients() const { return maxClients_; }
+    /// Set the side of the square, centered on the origin, client objects spawn at random in.
+    void SetSpawnSize(float size) { spawnSize_ = Max(size, 0.0f); }
+    float GetSpawnSize() const { return spawnSize_; }
+    /// Number of joining clients allowed to stream the scene and their initial snapshot at once, the rest wait in
+    /// order. 0 admits everyone immediately.
+    void SetMaxStreamingClients(unsigned maxStreaming) { maxStreamingClients_ = maxStreaming; }
+    unsigned GetMaxStreamingClients() const { return maxStreamingClients_; }
+    unsigned GetNumQueuedJoins() const;
+    unsigned GetNumStreamingJoins() const;
+    const LatencyHistogram& GetJoinHistogram(JoinHistogram index) const { return joinHistograms_[index]; }
 
-    Node* CreateClientObject(Connection *connection);
+    Node* CreateClientObject(Connection *connection, unsigned room = 0);
     void UpdatePhysicsPreStep(const Controls &controls);
 
+    /// Set the area-of-interest radius, client objects farther than this from a connection's own object are not
+    /// replicated to it. 0 replicates everything.
+    void SetInterestRadius(float radius) { interestRadius_ = radius; }
+    float GetInterestRadius() const { return interestRadius_; }
+    /// Return indices of client slots within the interest radius of a slot, as of the last network update. Without a
+    /// radius, every slot in the same room.
+    void GetRelevantClients(unsigned slot, PODVector<unsigned>& result) const;
+
+    /// Pick each connection's replication interval, in network updates, between these bounds from its rtt, packet loss
+    /// and send queue, and drop to the maximum when nothing near it moves. 1, 1 sends every update to everyone. Must be
+    /// set before clients connect.
+    void SetUpdateIntervalRange(unsigned minInterval, unsigned maxInterval);
+    unsigned GetMinUpdateInterval() const { return minUpdateInterval_; }
+    unsigned GetMaxUpdateInterval() const { return maxUpdateInterval_; }
+
+    /// Replicate client object transforms through the compact quantized stream instead of the engine's node and rigid
+    /// body attributes. Must be enabled before any scene is replicated, on the server and on every client.
+    void SetCompactTransforms(bool enable);
+    bool GetCompactTransforms() const { return compactTransforms_; }
+    /// Client: move the controlled object locally from its own inputs instead of waiting for the server, and reconcile
+    /// when the server's state arrives. Needs compact transforms, the engine's own transform attributes would
+    /// overwrite the prediction.
+    void SetClientPrediction(bool enable) { clientPrediction_ = enable; }
+    bool GetClientPrediction() const { return clientPrediction_; }
+    /// Client: show remote client objects this many seconds in the past, interpolated between received states. Needs
+    /// compact transforms. 0 applies states as they arrive.
+    void SetClientInterpolation(float delay) { clientInterpolationDelay_ = delay; }
+    float GetClientInterpolation() const { return clientInterpolationDelay_; }
+    /// Client: return the object this client controls, if it has been replicated yet.
+    ClientObj* GetClientObject() const;
+    /// Register the client object the server host controls directly, it has no connection.
+    void SetHostObject(Node *hostNode) { hostObject_ = hostNode; }
+
+    /// Add another room to host, with its own scene set up like the registered one (physics world, BallerSystem and
+    /// level collision). A joining client picks a room by name with the "Room" identity key, or is put in the least
+    /// populated room. The registered scene is room 0. Add rooms before the server starts.
+    void AddRoom(const String &name, Scene *scene);
+    unsigned GetNumRooms() const { return rooms_.Size(); }
+    const Room& GetRoom(unsigned index) const { return rooms_[index]; }
+    /// Return the number of clients joining or playing in a room.
+    unsigned GetNumRoomClients(unsigned index) const;
+    /// Return tick durations of a room's simulation, empty without the threaded simulation.
+    LatencyHistogram GetRoomTickTime(unsigned index) const;
+
+    /// Run the authoritative client object simulation on a pool of fixed rate threads instead of in the main loop's
+    /// physics step, each room's simulation on one of them, rooms on different threads concurrently. The replicated
+    /// scenes then only mirror the simulations' published states. Only connected clients' objects are simulated, not a
+    /// host object. Set before the server starts, after the scenes' physics worlds are set up.
+    void SetThreadedSimulation(bool enable, unsigned numThreads = 1);
+    bool GetThreadedSimulation() const { return threadedSimulation_; }
+    /// Deviation of server tick start times from the fixed physics period, from whichever threads run the ticks.
+    LatencyHistogram GetTickJitter() const;
+
+    /// Keep this many seconds of client object history per room for lag compensated queries, 0 disables. Set before the
+    /// server starts.
+    void SetLagCompensation(float seconds) { lagCompensationTime_ = seconds; }
+    float GetLagCompensation() const { return lagCompensationTime_; }
+    /// Clamp the interpolation delay clients report to this many seconds, and never past the lag compensation history.
+    void SetMaxInterpolationDelay(float seconds) { maxInterpolationDelay_ = Max(seconds, 0.0f); }
+    float GetMaxInterpolationDelay() const { return maxInterpolationDelay_; }
+    /// Rewind the client's room to what the client saw, half its rtt plus its interpolation delay ago but no further
+    /// than the history reaches, and return the history to run queries on. Restore it when done. NULL without lag
+    /// compensation.
+    LagCompensation* RewindForClient(unsigned slot);
+
+    /// Put client objects to sleep after this many seconds with no buttons held and a resting body, 0 never. Dormant
+    /// objects skip movement and physics and send no transform updates until input or a collision wakes them. Applies
+    /// to objects spawned after the call.
+    void SetDormancyTime(float seconds) { dormancyTime_ = Max(seconds, 0.0f); }
+    float GetDormancyTime() const { return dormancyTime_; }
+    unsigned GetNumDormantClients() const;
+
+    /// Record every client's controls per physics tick, and joins and leaves, to a binary log for 76_Network_Replay.
+    /// Start after the scene's physics world is set up. Not supported with more than one room or a threaded simulation.
+    bool StartInputRecording(const String &fileName);
+    void StopInputRecording();
+
+    /// Server: delivery counters of client input messages.
+    const InputStats& GetInputStats() const { return inputStats_; }
+
+    unsigned GetNumClients() const { return clients_.Size(); }
+    const Vector<ClientSlot>& GetClients() const { return clients_; }
+
 protected:
     void SubscribeToEvents();
     void SendStatusMsg(StringHash msg);
+    void SendRemoteEvent(Connection *connection, StringHash eventType, const VariantMap& eventData);
+    void SendClientInput();
 
     /// Handle the physics world pre-step event.
     void HandlePhysicsPreStep(StringHash eventType, VariantMap& eventData);
@@ -84,15 +301,89 @@ protected:
     /// Handle a client disconnecting from the server.
     void HandleClientDisconnected(StringHash eventType, VariantMap& eventData);
     /// Handle remote event from server which tells our controlled object node ID.
+    void HandleNetworkUpdate(StringHash eventType, VariantMap& eventData);
     void HandleNetworkUpdateSent(StringHash eventType, VariantMap& eventData);
+    void HandleNetworkMessage(StringHash eventType, VariantMap& eventData);
     void HandleClientObjectID(StringHash eventType, VariantMap& eventData);
     void HandleClientIdentity(StringHash eventType, VariantMap& eventData);
     void HandleClientSceneLoaded(StringHash eventType, VariantMap& eventData);
+    void HandleComponentAdded(StringHash eventType, VariantMap& eventData);
+    void HandleUpdate(StringHash eventType, VariantMap& eventData);
+
+    unsigned AddClientSlot(Connection *connection, Node *clientNode, unsigned room);
+    void RemoveClientSlot(Connection *connection);
+    void UpdateJoins();
+    void SpawnClient(Connection *connection, unsigned room);
+    void RemovePendingJoin(Connection *connection);
+    unsigned SelectRoom(Connection *connection) const;
+    void UpdateInterest();
+    void UpdateInterestCulling();
+    void UpdateActivity();
+    void UpdateAdaptiveRates();
+    unsigned SelectUpdateInterval(const ClientSlot& client) const;
+    void UpdateNetTransforms();
+    void RecordLagHistory();
+    void StartSimulation();
+    void StopSimulation();
+    void PushSimulationInputs();
+    void ApplySimulationSnapshot();
 
 protected:
-    /// Mapping from client connections to controllable objects.
-    HashMap<Connection*, WeakPtr<Node> > serverObjects_;
+    /// Client connections and their controllable objects, indexed by slot id.
+    Vector<ClientSlot> clients_;
+    HashMap<Connection*, unsigned> connectionSlots_;
+    InputStats inputStats_;
     StringHash clientHash_;
     unsigned clientObjectID_;
+    unsigned maxClients_;
+    ClientObjPool clientObjPool_;
+    unsigned clientPoolSize_;
+
+    /// Join pipeline.
+    Vector<PendingJoin> pendingJoins_;
+    unsigned maxStreamingClients_;
+    HiresTimer joinClock_;
+    LatencyHistogram joinHistograms_[MAX_JOINHIST];
+    /// Rooms, the threaded simulation, and tick jitter of the main loop's physics steps.
+    Vector<Room> rooms_;
+    bool threadedSimulation_;
+    unsigned numSimulationThreads_;
+    Vector<SimulationThread*> simulationThreads_;
+    HiresTimer tickClock_;
+    long long lastTickUSec_;
+    long long tickPeriodUSec_;
+    LatencyHistogram tickJitter_;
+    /// Seconds of history kept for lag compensation.
+    float lagCompensationTime_;
+    /// Largest interpolation delay accepted from a client's identity.
+    float maxInterpolationDelay_;
+    /// Idle seconds before a client object goes dormant, 0 never.
+    float dormancyTime_;
+    float spawnSize_;
+    /// Input recording.
+    InputLogWriter inputLog_;
+    unsigned nextRecordId_;
+
+    /// Area of interest.
+    float interestRadius_;
+    InterestGrid interestGrid_;
+    PODVector<Vector3> interestPositions_;
+    /// Whether anything moved in each room, by room index.
+    PODVector<bool> roomMoving_;
+    /// Adaptive update rate.
+    unsigned minUpdateInterval_;
+    unsigned maxUpdateInterval_;
+    /// Client: interest radius received from the server.
+    float clientInterestRadius_;
+    /// Client: prediction, the sequence number of the next input sent, and the input message.
+    bool clientPrediction_;
+    unsigned inputSeq_;
+    InputSender inputSender_;
+    VectorBuffer inputMsg_;
+    /// Client: interpolation delay for remote objects.
+    float clientInterpolationDelay_;
+
+    bool compactTransforms_;
+    WeakPtr<Node> hostObject_;
     SharedPtr<Scene> scene_;
 };
@@ -0,0 +1,93 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <Urho3D/Core/Timer.h>
+
+#include "SimulationThread.h"
+#include "RoomSimulation.h"
+
+#include <Urho3D/DebugNew.h>
+//=============================================================================
+//=============================================================================
+SimulationThread::SimulationThread(int fps)
+    : fps_(Max(fps, 1))
+{
+}
+
+SimulationThread::~SimulationThread()
+{
+    Stop();
+}
+
+LatencyHistogram SimulationThread::GetTickJitter() const
+{
+    MutexLock lock(mutex_);
+    return tickJitter_;
+}
+
+LatencyHistogram SimulationThread::GetTickTime() const
+{
+    MutexLock lock(mutex_);
+    return tickTime_;
+}
+
+void SimulationThread::ThreadFunction()
+{
+    const long long period = 1000000LL / fps_;
+    const float timeStep = 1.0f / (float)fps_;
+
+    HiresTimer clock;
+    HiresTimer tickTimer;
+    long long nextTick = 0;
+    long long lastTick = -1;
+
+    while (shouldRun_)
+    {
+        long long now = clock.GetUSec(false);
+
+        // sleep off most of the wait, the last millisecond is yielded away to hit the tick closely
+        if (now < nextTick)
+        {
+            Time::Sleep(nextTick - now > 2000 ? (unsigned)((nextTick - now) / 1000) - 1 : 0);
+            continue;
+        }
+
+        // more than a tick behind, e.g. a long join, resume the fixed rate from now rather than burst to catch up
+        nextTick = now - nextTick > period ? now + period : nextTick + period;
+
+        tickTimer.Reset();
+        for (unsigned i = 0; i < rooms_.Size(); ++i)
+        {
+            rooms_[i]->Tick(timeStep);
+        }
+        long long tickTime = tickTimer.GetUSec(false);
+
+        MutexLock lock(mutex_);
+        if (lastTick >= 0)
+        {
+            tickJitter_.Record(Abs(now - lastTick - period) / 1000.0f);
+        }
+        lastTick = now;
+        tickTime_.Record(tickTime / 1000.0f);
+    }
+}
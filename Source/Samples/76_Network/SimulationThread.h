@@ -0,0 +1,66 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include <Urho3D/Container/Ptr.h>
+#include <Urho3D/Container/Vector.h>
+#include <Urho3D/Core/Mutex.h>
+#include <Urho3D/Core/Thread.h>
+
+#include "LatencyHistogram.h"
+
+using namespace Urho3D;
+//=============================================================================
+//=============================================================================
+class RoomSimulation;
+
+//=============================================================================
+//=============================================================================
+/// Server: one worker of the simulation pool. Ticks its rooms one after the other at a fixed rate on its own thread,
+/// decoupled from the frame loop. Rooms are spread over the pool's workers when the server starts.
+class SimulationThread : public Thread
+{
+public:
+    SimulationThread(int fps);
+    virtual ~SimulationThread();
+
+    /// Add a room to tick, before Run.
+    void AddRoom(RoomSimulation* room) { rooms_.Push(SharedPtr<RoomSimulation>(room)); }
+    unsigned GetNumRooms() const { return rooms_.Size(); }
+
+    /// Deviation of tick start times from the fixed period, and durations of whole ticks over all rooms.
+    LatencyHistogram GetTickJitter() const;
+    LatencyHistogram GetTickTime() const;
+
+    virtual void ThreadFunction();
+
+private:
+    Vector<SharedPtr<RoomSimulation> > rooms_;
+    int fps_;
+
+    /// Guards the histograms.
+    mutable Mutex mutex_;
+    LatencyHistogram tickJitter_;
+    LatencyHistogram tickTime_;
+};
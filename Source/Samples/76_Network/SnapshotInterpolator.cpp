@@ -0,0 +1,175 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Physics/RigidBody.h>
+#include <Urho3D/Scene/Node.h>
+
+#include "SnapshotInterpolator.h"
+#include "ClientObj.h"
+
+#include <Urho3D/DebugNew.h>
+//=============================================================================
+//=============================================================================
+SnapshotInterpolator::SnapshotInterpolator(Context* context)
+    : LogicComponent(context)
+    , head_(0)
+    , count_(0)
+    , clock_(0.0f)
+    , clockStarted_(false)
+    , delay_(0.1f)
+    , maxExtrapolation_(0.25f)
+    , numExtrapolated_(0)
+{
+    SetUpdateEventMask(USE_POSTUPDATE);
+}
+
+SnapshotInterpolator::~SnapshotInterpolator()
+{
+    // hand the body back to the local physics
+    if (body_)
+    {
+        body_->SetKinematic(false);
+    }
+}
+
+void SnapshotInterpolator::RegisterObject(Context* context)
+{
+    context->RegisterFactory<SnapshotInterpolator>();
+}
+
+void SnapshotInterpolator::OnNodeSet(Node* node)
+{
+    LogicComponent::OnNodeSet(node);
+
+    if (node)
+    {
+        clientObj_ = node->GetDerivedComponent<ClientObj>();
+    }
+    else if (body_)
+    {
+        body_->SetKinematic(false);
+        body_.Reset();
+    }
+}
+
+void SnapshotInterpolator::AddSnapshot(const TransformState& state, float serverTime)
+{
+    const float CLOCK_CORRECTION = 0.1f;
+    const float RESYNC_TIME = 1.0f;
+
+    // first state, or the server timeline jumped, e.g. after a long dormancy, start over from it. Otherwise slew the
+    // clock toward the state's time, which averages out the arrival jitter
+    if (!clockStarted_ || Abs(serverTime - clock_) > RESYNC_TIME)
+    {
+        clock_ = serverTime;
+        clockStarted_ = true;
+        count_ = 0;
+    }
+    else
+    {
+        clock_ += (serverTime - clock_) * CLOCK_CORRECTION;
+    }
+
+    // arrived out of order, the newer state already covers it
+    if (count_ && serverTime <= GetTime(count_ - 1))
+        return;
+
+    // full, overwrite the oldest
+    if (count_ == NUM_SNAPSHOTS)
+    {
+        head_ = (head_ + 1) % NUM_SNAPSHOTS;
+        --count_;
+    }
+
+    unsigned index = (head_ + count_) % NUM_SNAPSHOTS;
+    states_[index] = state;
+    times_[index] = serverTime;
+    ++count_;
+}
+
+bool SnapshotInterpolator::Sample(float renderTime, TransformState& result)
+{
+    if (count_ == 0)
+        return false;
+
+    // older than anything buffered, hold the oldest
+    if (renderTime <= GetTime(0))
+    {
+        result = GetState(0);
+        return true;
+    }
+
+    // drop states that are fully behind the render time, keeping one before it to interpolate from
+    while (count_ > 1 && GetTime(1) <= renderTime)
+    {
+        head_ = (head_ + 1) % NUM_SNAPSHOTS;
+        --count_;
+    }
+
+    // past the newest, extrapolate a short while then hold
+    if (count_ == 1)
+    {
+        const TransformState& last = GetState(0);
+        float dt = Min(renderTime - GetTime(0), maxExtrapolation_);
+
+        result = last;
+        result.position_ += last.linearVelocity_ * dt;
+        ++numExtrapolated_;
+        return true;
+    }
+
+    const TransformState& from = GetState(0);
+    const TransformState& to = GetState(1);
+    float t = (renderTime - GetTime(0)) / Max(GetTime(1) - GetTime(0), M_EPSILON);
+
+    result.position_ = from.position_.Lerp(to.position_, t);
+    result.rotation_ = from.rotation_.Slerp(to.rotation_, t);
+    result.linearVelocity_ = from.linearVelocity_.Lerp(to.linearVelocity_, t);
+    result.angularVelocity_ = from.angularVelocity_.Lerp(to.angularVelocity_, t);
+    return true;
+}
+
+void SnapshotInterpolator::PostUpdate(float timeStep)
+{
+    clock_ += timeStep;
+
+    if (!clientObj_)
+        return;
+
+    // the body is created in the client object's delayed start, take it over once it's there
+    if (!body_)
+    {
+        body_ = node_->GetComponent<RigidBody>();
+
+        if (body_)
+        {
+            body_->SetKinematic(true);
+        }
+    }
+
+    TransformState state;
+    if (Sample(clock_ - delay_, state))
+    {
+        clientObj_->ApplyTransformState(state);
+    }
+}
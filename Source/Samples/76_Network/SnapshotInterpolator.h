@@ -0,0 +1,95 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include <Urho3D/Scene/LogicComponent.h>
+
+#include "TransformCodec.h"
+
+namespace Urho3D
+{
+class RigidBody;
+}
+
+using namespace Urho3D;
+//=============================================================================
+//=============================================================================
+class ClientObj;
+
+//=============================================================================
+//=============================================================================
+/// Client: smooths a remote client object. Received states go into a small ring buffer at the server time they were
+/// taken, so network jitter doesn't bend their spacing. A local estimate of the server clock runs with the frame time
+/// and is pulled toward each arriving state's time, and the node is shown a fixed delay behind it, interpolated between
+/// the two states around that time. Short gaps past the newest state are extrapolated from its velocity. The body is
+/// made kinematic so the local physics doesn't fight it.
+class SnapshotInterpolator : public LogicComponent
+{
+    URHO3D_OBJECT(SnapshotInterpolator, LogicComponent);
+
+public:
+    SnapshotInterpolator(Context* context);
+    virtual ~SnapshotInterpolator();
+
+    static void RegisterObject(Context* context);
+
+    /// Add a state received from the server, taken at serverTime. States older than the newest one are dropped.
+    void AddSnapshot(const TransformState& state, float serverTime);
+
+    /// Set how far in the past states are shown, should cover at least two server update intervals.
+    void SetDelay(float delay) { delay_ = delay; }
+    float GetDelay() const { return delay_; }
+    /// Set how long to extrapolate past the newest state before holding still.
+    void SetMaxExtrapolation(float time) { maxExtrapolation_ = time; }
+    float GetMaxExtrapolation() const { return maxExtrapolation_; }
+
+    /// Number of frames that had to extrapolate, counts gaps in the stream.
+    unsigned GetNumExtrapolated() const { return numExtrapolated_; }
+
+    static const unsigned NUM_SNAPSHOTS = 16;
+
+protected:
+    virtual void OnNodeSet(Node* node);
+    virtual void PostUpdate(float timeStep);
+
+    /// Return the snapshot n places after the oldest.
+    const TransformState& GetState(unsigned n) const { return states_[(head_ + n) % NUM_SNAPSHOTS]; }
+    float GetTime(unsigned n) const { return times_[(head_ + n) % NUM_SNAPSHOTS]; }
+    bool Sample(float renderTime, TransformState& result);
+
+protected:
+    WeakPtr<ClientObj> clientObj_;
+    WeakPtr<RigidBody> body_;
+
+    TransformState states_[NUM_SNAPSHOTS];
+    float times_[NUM_SNAPSHOTS];
+    unsigned head_;
+    unsigned count_;
+
+    /// Estimated current server time.
+    float clock_;
+    bool clockStarted_;
+    float delay_;
+    float maxExtrapolation_;
+    unsigned numExtrapolated_;
+};
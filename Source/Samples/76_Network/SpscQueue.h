@@ -0,0 +1,71 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include <atomic>
+
+//=============================================================================
+//=============================================================================
+/// Fixed capacity lock-free ring for exactly one producer thread and one consumer thread. Push fails when the ring is
+/// full rather than blocking. CAPACITY must be a power of two.
+template <class T, unsigned CAPACITY> class SpscQueue
+{
+public:
+    SpscQueue()
+        : head_(0)
+        , tail_(0)
+    {
+    }
+
+    /// Producer: append an item, returns false if the ring is full.
+    bool Push(const T& item)
+    {
+        unsigned tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) >= CAPACITY)
+            return false;
+
+        items_[tail & (CAPACITY - 1)] = item;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// Consumer: take the oldest item, returns false if the ring is empty.
+    bool Pop(T& item)
+    {
+        unsigned head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire))
+            return false;
+
+        item = items_[head & (CAPACITY - 1)];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    /// Next slot to pop, written by the consumer only.
+    std::atomic<unsigned> head_;
+    /// Next slot to push, written by the producer only.
+    std::atomic<unsigned> tail_;
+    T items_[CAPACITY];
+};
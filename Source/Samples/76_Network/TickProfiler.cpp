@@ -0,0 +1,348 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <Urho3D/Core/CoreEvents.h>
+#include <Urho3D/IO/File.h>
+#include <Urho3D/IO/FileSystem.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/Network/Network.h>
+#include <Urho3D/Network/NetworkEvents.h>
+#include <Urho3D/Physics/PhysicsEvents.h>
+
+#include "TickProfiler.h"
+
+#include <Urho3D/DebugNew.h>
+//=============================================================================
+//=============================================================================
+const float TickProfiler::DUMP_COOLDOWN = 30.0f;
+
+// ten seconds of 60Hz ticks and network updates until SetRecorderLength says otherwise
+static const float DEFAULT_RECORDER_SECONDS = 10.0f;
+static const unsigned DEFAULT_SAMPLES_PER_SECOND = 120;
+
+static const char* stageNames[] =
+{
+    "tick",
+    "input",
+    "ballers",
+    "physics",
+    "netsend"
+};
+
+//=============================================================================
+//=============================================================================
+FlightRecorder::FlightRecorder()
+    : capacity_(0)
+    , head_(0)
+{
+}
+
+void FlightRecorder::SetCapacity(unsigned capacity)
+{
+    capacity_ = NextPowerOfTwo(Max(capacity, 2U));
+    slots_ = new Slot[capacity_];
+    head_.store(0, std::memory_order_relaxed);
+}
+
+void FlightRecorder::Write(const TickSample& sample)
+{
+    if (!capacity_)
+        return;
+
+    unsigned long long index = head_.fetch_add(1, std::memory_order_relaxed);
+    Slot& slot = slots_.Get()[index & (capacity_ - 1)];
+
+    slot.seq_.store(index * 2 + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.sample_ = sample;
+    slot.seq_.store(index * 2 + 2, std::memory_order_release);
+}
+
+bool FlightRecorder::Read(unsigned long long index, TickSample& sample) const
+{
+    if (!capacity_)
+        return false;
+
+    const Slot& slot = slots_.Get()[index & (capacity_ - 1)];
+
+    unsigned long long seq = slot.seq_.load(std::memory_order_acquire);
+    if (seq != index * 2 + 2)
+        return false;
+
+    sample = slot.sample_;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot.seq_.load(std::memory_order_relaxed) == seq;
+}
+
+//=============================================================================
+//=============================================================================
+TickProfiler::TickProfiler(Context* context)
+    : Object(context)
+    , readIndex_(0)
+    , tickOpen_(false)
+    , tick_(0)
+    , netUpdate_(0)
+    , tickBudgetMs_(0.0f)
+    , lastDumpUSec_(-1)
+    , numOverruns_(0)
+    , numDropped_(0)
+{
+    for (unsigned i = 0; i < MAX_TICKSTAGES; ++i)
+    {
+        stageStartUSec_[i] = 0;
+    }
+
+    SetRecorderLength(DEFAULT_RECORDER_SECONDS, DEFAULT_SAMPLES_PER_SECOND);
+
+    SubscribeToEvent(E_PHYSICSPRESTEP, URHO3D_HANDLER(TickProfiler, HandlePhysicsPreStep));
+    SubscribeToEvent(E_PHYSICSPOSTSTEP, URHO3D_HANDLER(TickProfiler, HandlePhysicsPostStep));
+    SubscribeToEvent(E_NETWORKUPDATE, URHO3D_HANDLER(TickProfiler, HandleNetworkUpdate));
+    SubscribeToEvent(E_NETWORKUPDATESENT, URHO3D_HANDLER(TickProfiler, HandleNetworkUpdateSent));
+    SubscribeToEvent(E_ENDFRAME, URHO3D_HANDLER(TickProfiler, HandleEndFrame));
+}
+
+TickProfiler::~TickProfiler()
+{
+}
+
+void TickProfiler::SetRecorderLength(float seconds, unsigned samplesPerSecond)
+{
+    recorder_.SetCapacity((unsigned)CeilToInt(seconds * samplesPerSecond));
+    readIndex_ = 0;
+}
+
+void TickProfiler::SetTickBudget(float budgetMs, const String &dumpDir)
+{
+    tickBudgetMs_ = budgetMs;
+    dumpDir_ = AddTrailingSlash(dumpDir);
+}
+
+const char* TickProfiler::GetStageName(TickStage stage)
+{
+    return stageNames[stage];
+}
+
+void TickProfiler::OpenTick()
+{
+    current_ = TickSample();
+    current_.tick_ = ++tick_;
+    current_.startUSec_ = clock_.GetUSec(false);
+    stageStartUSec_[TICKSTAGE_TICK] = current_.startUSec_;
+    tickOpen_ = true;
+}
+
+void TickProfiler::BeginStage(TickStage stage)
+{
+    // whichever pre-step handler runs first starts the tick, the engine doesn't order them
+    if (stage != TICKSTAGE_NETSEND && !tickOpen_)
+    {
+        OpenTick();
+    }
+
+    stageStartUSec_[stage] = clock_.GetUSec(false);
+}
+
+void TickProfiler::EndStage(TickStage stage)
+{
+    unsigned usec = (unsigned)(clock_.GetUSec(false) - stageStartUSec_[stage]);
+
+    if (stage == TICKSTAGE_NETSEND)
+    {
+        TickSample sample;
+        sample.tick_ = ++netUpdate_;
+        sample.startUSec_ = stageStartUSec_[stage];
+        sample.stageUSec_[stage] = usec;
+        sample.stageMask_ = 1u << stage;
+        recorder_.Write(sample);
+        return;
+    }
+
+    if (!tickOpen_)
+        return;
+
+    current_.stageUSec_[stage] += usec;
+    current_.stageMask_ |= 1u << stage;
+}
+
+void TickProfiler::ProcessSamples()
+{
+    unsigned long long head = recorder_.GetNumWritten();
+    unsigned capacity = recorder_.GetCapacity();
+
+    if (head - readIndex_ > capacity)
+    {
+        numDropped_ += (unsigned)(head - readIndex_ - capacity);
+        readIndex_ = head - capacity;
+    }
+
+    float worstMs = 0.0f;
+    TickSample sample;
+
+    for (; readIndex_ < head; ++readIndex_)
+    {
+        if (!recorder_.Read(readIndex_, sample))
+        {
+            // a writer on another thread is still copying it in, take it next frame
+            if (readIndex_ + capacity > recorder_.GetNumWritten())
+                break;
+
+            ++numDropped_;
+            continue;
+        }
+
+        for (unsigned i = 0; i < MAX_TICKSTAGES; ++i)
+        {
+            if (sample.stageMask_ & (1u << i))
+            {
+                histograms_[i].Record(sample.stageUSec_[i] / 1000.0f);
+            }
+        }
+
+        if (tickBudgetMs_ > 0.0f && (sample.stageMask_ & (1u << TICKSTAGE_TICK)))
+        {
+            float tickMs = sample.stageUSec_[TICKSTAGE_TICK] / 1000.0f;
+            if (tickMs > tickBudgetMs_)
+            {
+                ++numOverruns_;
+                worstMs = Max(worstMs, tickMs);
+            }
+        }
+    }
+
+    if (worstMs <= 0.0f)
+        return;
+
+    // keep the disk out of a run of slow ticks
+    long long now = clock_.GetUSec(false);
+    if (lastDumpUSec_ >= 0 && now - lastDumpUSec_ < (long long)(DUMP_COOLDOWN * 1000000.0f))
+        return;
+    lastDumpUSec_ = now;
+
+    String fileName = dumpDir_ + ToString("flight_%u.csv", Time::GetSystemTime());
+    URHO3D_LOGWARNINGF("tick took %.2fms against a %.2fms budget, flight recorder dumped to %s", worstMs, tickBudgetMs_,
+        fileName.CString());
+    DumpRecorder(fileName);
+}
+
+bool TickProfiler::DumpRecorder(const String &fileName) const
+{
+    SharedPtr<File> file(new File(context_, fileName, FILE_WRITE));
+
+    if (!file->IsOpen())
+    {
+        URHO3D_LOGERRORF("TickProfiler could not open %s", fileName.CString());
+        return false;
+    }
+
+    String line = "source,tick,start_ms";
+    for (unsigned i = 0; i < MAX_TICKSTAGES; ++i)
+    {
+        line += ToString(",%s_us", stageNames[i]);
+    }
+    file->WriteLine(line);
+
+    unsigned long long head = recorder_.GetNumWritten();
+    unsigned long long start = head > recorder_.GetCapacity() ? head - recorder_.GetCapacity() : 0;
+    TickSample sample;
+
+    for (unsigned long long i = start; i < head; ++i)
+    {
+        if (!recorder_.Read(i, sample))
+            continue;
+
+        line = ToString("%u,%u,%.3f", sample.source_, sample.tick_, sample.startUSec_ / 1000.0);
+        for (unsigned s = 0; s < MAX_TICKSTAGES; ++s)
+        {
+            line += (sample.stageMask_ & (1u << s)) ? ToString(",%u", sample.stageUSec_[s]) : String(",");
+        }
+        file->WriteLine(line);
+    }
+
+    return true;
+}
+
+void TickProfiler::ResetHistograms()
+{
+    // samples still waiting in the recorder belong to before the reset
+    ProcessSamples();
+
+    for (unsigned i = 0; i < MAX_TICKSTAGES; ++i)
+    {
+        histograms_[i].Reset();
+    }
+}
+
+void TickProfiler::LogSummary() const
+{
+    for (unsigned i = 0; i < MAX_TICKSTAGES; ++i)
+    {
+        URHO3D_LOGINFOF("tick profile %s: %s", stageNames[i], histograms_[i].ToString().CString());
+    }
+    URHO3D_LOGINFOF("tick profile: %u ticks over a %.2fms budget, %u samples dropped", numOverruns_, tickBudgetMs_,
+        numDropped_);
+}
+
+void TickProfiler::HandlePhysicsPreStep(StringHash eventType, VariantMap& eventData)
+{
+    if (!tickOpen_)
+    {
+        OpenTick();
+    }
+}
+
+void TickProfiler::HandlePhysicsPostStep(StringHash eventType, VariantMap& eventData)
+{
+    if (!tickOpen_)
+        return;
+
+    unsigned total = (unsigned)(clock_.GetUSec(false) - current_.startUSec_);
+    unsigned timed = current_.stageUSec_[TICKSTAGE_INPUT] + current_.stageUSec_[TICKSTAGE_BALLERS];
+
+    current_.stageUSec_[TICKSTAGE_TICK] = total;
+    current_.stageUSec_[TICKSTAGE_PHYSICS] = total > timed ? total - timed : 0;
+    current_.stageMask_ |= (1u << TICKSTAGE_TICK) | (1u << TICKSTAGE_PHYSICS);
+    recorder_.Write(current_);
+
+    tickOpen_ = false;
+}
+
+void TickProfiler::HandleNetworkUpdate(StringHash eventType, VariantMap& eventData)
+{
+    if (GetSubsystem<Network>()->IsServerRunning())
+    {
+        BeginStage(TICKSTAGE_NETSEND);
+    }
+}
+
+void TickProfiler::HandleNetworkUpdateSent(StringHash eventType, VariantMap& eventData)
+{
+    if (GetSubsystem<Network>()->IsServerRunning())
+    {
+        EndStage(TICKSTAGE_NETSEND);
+    }
+}
+
+void TickProfiler::HandleEndFrame(StringHash eventType, VariantMap& eventData)
+{
+    ProcessSamples();
+}
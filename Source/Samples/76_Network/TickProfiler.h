@@ -0,0 +1,210 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include <Urho3D/Container/ArrayPtr.h>
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Core/Timer.h>
+
+#include <atomic>
+
+#include "LatencyHistogram.h"
+
+using namespace Urho3D;
+//=============================================================================
+//=============================================================================
+/// Timed parts of a server tick. The physics stage is what is left of the tick after input and ball movement: the
+/// Bullet step and any other pre and post-step handlers. Network send is timed per network update, outside the ticks.
+enum TickStage
+{
+    TICKSTAGE_TICK = 0,
+    TICKSTAGE_INPUT,
+    TICKSTAGE_BALLERS,
+    TICKSTAGE_PHYSICS,
+    TICKSTAGE_NETSEND,
+    MAX_TICKSTAGES
+};
+
+/// One timed tick, or one network update.
+struct TickSample
+{
+    TickSample()
+        : tick_(0)
+        , source_(0)
+        , startUSec_(0)
+        , stageMask_(0)
+    {
+        for (unsigned i = 0; i < MAX_TICKSTAGES; ++i)
+        {
+            stageUSec_[i] = 0;
+        }
+    }
+
+    unsigned tick_;
+    /// 0 for the main loop, room index + 1 for a room's simulation.
+    unsigned source_;
+    /// Start time on the profiler's clock.
+    long long startUSec_;
+    /// Stage durations, bit i of the mask set when stage i was timed.
+    unsigned stageUSec_[MAX_TICKSTAGES];
+    unsigned stageMask_;
+};
+
+//=============================================================================
+//=============================================================================
+/// Fixed capacity ring of the most recent tick samples, written from any number of threads without locks. A writer
+/// claims a slot by bumping the write index and stamps the slot's sequence before and after copying the sample in, a
+/// reader that sees the stamp change while copying out drops the sample instead of waiting.
+class FlightRecorder
+{
+public:
+    FlightRecorder();
+
+    /// Allocate, rounded up to a power of two. Set before any thread writes.
+    void SetCapacity(unsigned capacity);
+    unsigned GetCapacity() const { return capacity_; }
+    /// Any thread: store a sample, overwriting the oldest.
+    void Write(const TickSample& sample);
+    /// Return the number of samples ever written, the newest has index GetNumWritten() - 1.
+    unsigned long long GetNumWritten() const { return head_.load(std::memory_order_acquire); }
+    /// Copy out the sample with a write index, returns false if it was overwritten or is still being written.
+    bool Read(unsigned long long index, TickSample& sample) const;
+
+private:
+    struct Slot
+    {
+        Slot()
+            : seq_(0)
+        {
+        }
+
+        /// 2 * index + 1 while being written, 2 * index + 2 once written.
+        std::atomic<unsigned long long> seq_;
+        TickSample sample_;
+    };
+
+    SharedArrayPtr<Slot> slots_;
+    unsigned capacity_;
+    std::atomic<unsigned long long> head_;
+};
+
+//=============================================================================
+//=============================================================================
+/// Server tick profiler. Times the main loop's physics ticks by stage and its network updates, and takes finished
+/// samples from room simulation threads. Every sample goes into the flight recorder; once a frame the main thread reads
+/// the new ones into per-stage histograms, and when a tick ran over its budget, dumps the recorder to a csv file.
+///
+/// The hot path is a clock read per stage edge and one recorder write per tick, cheap enough to leave on.
+class TickProfiler : public Object
+{
+    URHO3D_OBJECT(TickProfiler, Object);
+
+public:
+    TickProfiler(Context* context);
+    virtual ~TickProfiler();
+
+    /// Keep the last seconds of samples, at up to samplesPerSecond from all sources together.
+    void SetRecorderLength(float seconds, unsigned samplesPerSecond);
+    /// Dump the flight recorder into dumpDir when a tick takes longer than budgetMs, at most once per DUMP_COOLDOWN
+    /// seconds. 0 disables.
+    void SetTickBudget(float budgetMs, const String &dumpDir);
+    float GetTickBudget() const { return tickBudgetMs_; }
+
+    /// Main thread: time a stage of the current tick, the first stage begun opens the tick.
+    void BeginStage(TickStage stage);
+    void EndStage(TickStage stage);
+    /// Any thread: add a sample timed elsewhere.
+    void Submit(const TickSample& sample) { recorder_.Write(sample); }
+    /// Any thread: current time on the profiler's clock.
+    long long GetUSec() const { return clock_.GetUSec(false); }
+
+    const LatencyHistogram& GetHistogram(TickStage stage) const { return histograms_[stage]; }
+    /// Start the histograms over, e.g. once a warm-up is done. The flight recorder keeps its samples.
+    void ResetHistograms();
+    unsigned GetNumOverruns() const { return numOverruns_; }
+    /// Samples overwritten before the main thread got to read them.
+    unsigned GetNumDropped() const { return numDropped_; }
+    /// Write every sample in the recorder to a csv file, oldest first.
+    bool DumpRecorder(const String &fileName) const;
+    /// Log a line per stage histogram.
+    void LogSummary() const;
+    static const char* GetStageName(TickStage stage);
+
+    static const float DUMP_COOLDOWN;
+
+protected:
+    void OpenTick();
+    void ProcessSamples();
+
+    void HandlePhysicsPreStep(StringHash eventType, VariantMap& eventData);
+    void HandlePhysicsPostStep(StringHash eventType, VariantMap& eventData);
+    void HandleNetworkUpdate(StringHash eventType, VariantMap& eventData);
+    void HandleNetworkUpdateSent(StringHash eventType, VariantMap& eventData);
+    void HandleEndFrame(StringHash eventType, VariantMap& eventData);
+
+protected:
+    FlightRecorder recorder_;
+    /// Write index of the next sample to read into the histograms.
+    unsigned long long readIndex_;
+    LatencyHistogram histograms_[MAX_TICKSTAGES];
+
+    /// Main loop tick being timed.
+    mutable HiresTimer clock_;
+    TickSample current_;
+    bool tickOpen_;
+    long long stageStartUSec_[MAX_TICKSTAGES];
+    unsigned tick_;
+    unsigned netUpdate_;
+
+    float tickBudgetMs_;
+    String dumpDir_;
+    long long lastDumpUSec_;
+    unsigned numOverruns_;
+    unsigned numDropped_;
+};
+
+//=============================================================================
+//=============================================================================
+/// Times a main loop tick stage for the lifetime of the scope, does nothing without a TickProfiler subsystem.
+class TickProfileScope
+{
+public:
+    TickProfileScope(TickProfiler* profiler, TickStage stage)
+        : profiler_(profiler)
+        , stage_(stage)
+    {
+        if (profiler_)
+            profiler_->BeginStage(stage_);
+    }
+
+    ~TickProfileScope()
+    {
+        if (profiler_)
+            profiler_->EndStage(stage_);
+    }
+
+private:
+    TickProfiler* profiler_;
+    TickStage stage_;
+};
@@ -0,0 +1,358 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/IO/Deserializer.h>
+#include <Urho3D/IO/Serializer.h>
+#include <Urho3D/IO/VectorBuffer.h>
+#include <Urho3D/Physics/RigidBody.h>
+#include <Urho3D/Scene/Node.h>
+
+#include "TransformCodec.h"
+
+#include <Urho3D/DebugNew.h>
+//=============================================================================
+//=============================================================================
+const float TransformCodec::VELOCITY_STEP = 0.01f;
+
+static const unsigned char FLAG_KEYFRAME         = (1<<0);
+static const unsigned char FLAG_POSITION         = (1<<1);
+static const unsigned char FLAG_ROTATION         = (1<<2);
+static const unsigned char FLAG_LINEAR_VELOCITY  = (1<<3);
+static const unsigned char FLAG_ANGULAR_VELOCITY = (1<<4);
+
+static const float POSITION_RANGE = 65535.0f;
+static const float ROTATION_RANGE = 1023.0f;
+static const float ROTATION_MAX = 0.70710678f;
+static const int MAX_VELOCITY = (1<<20);
+static const float TIMESTAMP_SCALE = 1000.0f;
+static const unsigned REORDER_WINDOW_MS = 1000;
+
+static inline unsigned ZigZag(int value)
+{
+    return ((unsigned)value << 1) ^ (unsigned)(value >> 31);
+}
+
+static inline int UnZigZag(unsigned value)
+{
+    return (int)(value >> 1) ^ -(int)(value & 1);
+}
+
+static void WriteDeltas(Serializer& dest, const int* value, const int* baseline)
+{
+    for (unsigned i = 0; i < 3; ++i)
+    {
+        dest.WriteVLE(ZigZag(value[i] - baseline[i]));
+    }
+}
+
+static void ReadDeltas(Deserializer& source, int* value, const int* baseline)
+{
+    for (unsigned i = 0; i < 3; ++i)
+    {
+        value[i] = baseline[i] + UnZigZag(source.ReadVLE());
+    }
+}
+
+static void QuantizeVelocity(const Vector3& value, int* quantized)
+{
+    quantized[0] = Clamp(RoundToInt(value.x_ / TransformCodec::VELOCITY_STEP), -MAX_VELOCITY, MAX_VELOCITY);
+    quantized[1] = Clamp(RoundToInt(value.y_ / TransformCodec::VELOCITY_STEP), -MAX_VELOCITY, MAX_VELOCITY);
+    quantized[2] = Clamp(RoundToInt(value.z_ / TransformCodec::VELOCITY_STEP), -MAX_VELOCITY, MAX_VELOCITY);
+}
+
+static Vector3 DequantizeVelocity(const int* quantized)
+{
+    return Vector3(quantized[0], quantized[1], quantized[2]) * TransformCodec::VELOCITY_STEP;
+}
+
+static bool EqualTriple(const int* lhs, const int* rhs)
+{
+    return lhs[0] == rhs[0] && lhs[1] == rhs[1] && lhs[2] == rhs[2];
+}
+
+//=============================================================================
+//=============================================================================
+bool QuantizedTransform::operator ==(const QuantizedTransform& rhs) const
+{
+    return EqualTriple(position_, rhs.position_) && rotation_ == rhs.rotation_ &&
+        EqualTriple(linearVelocity_, rhs.linearVelocity_) && EqualTriple(angularVelocity_, rhs.angularVelocity_);
+}
+
+//=============================================================================
+//=============================================================================
+TransformCodec::TransformCodec()
+    : bounds_(Vector3(-256.0f, -32.0f, -256.0f), Vector3(256.0f, 96.0f, 256.0f))
+{
+}
+
+QuantizedTransform TransformCodec::Quantize(const TransformState& state) const
+{
+    QuantizedTransform quantized;
+
+    // position
+    Vector3 size = bounds_.Size();
+    Vector3 t = (state.position_ - bounds_.min_) / size;
+    quantized.position_[0] = RoundToInt(Clamp(t.x_, 0.0f, 1.0f) * POSITION_RANGE);
+    quantized.position_[1] = RoundToInt(Clamp(t.y_, 0.0f, 1.0f) * POSITION_RANGE);
+    quantized.position_[2] = RoundToInt(Clamp(t.z_, 0.0f, 1.0f) * POSITION_RANGE);
+
+    // rotation, smallest three. q and -q are the same rotation, so flip to make the dropped component positive
+    Quaternion q = state.rotation_.Normalized();
+    float components[4] = { q.w_, q.x_, q.y_, q.z_ };
+    unsigned largest = 0;
+    for (unsigned i = 1; i < 4; ++i)
+    {
+        if (Abs(components[i]) > Abs(components[largest]))
+            largest = i;
+    }
+    float sign = components[largest] < 0.0f ? -1.0f : 1.0f;
+
+    quantized.rotation_ = largest;
+    unsigned shift = 2;
+    for (unsigned i = 0; i < 4; ++i)
+    {
+        if (i == largest)
+            continue;
+
+        float normalized = Clamp(components[i] * sign / ROTATION_MAX, -1.0f, 1.0f);
+        unsigned bits = (unsigned)RoundToInt((normalized * 0.5f + 0.5f) * ROTATION_RANGE);
+        quantized.rotation_ |= bits << shift;
+        shift += 10;
+    }
+
+    QuantizeVelocity(state.linearVelocity_, quantized.linearVelocity_);
+    QuantizeVelocity(state.angularVelocity_, quantized.angularVelocity_);
+
+    return quantized;
+}
+
+TransformState TransformCodec::Dequantize(const QuantizedTransform& quantized) const
+{
+    TransformState state;
+
+    Vector3 size = bounds_.Size();
+    state.position_ = bounds_.min_ + Vector3(
+        quantized.position_[0] / POSITION_RANGE * size.x_,
+        quantized.position_[1] / POSITION_RANGE * size.y_,
+        quantized.position_[2] / POSITION_RANGE * size.z_);
+
+    unsigned largest = quantized.rotation_ & 3;
+    float components[4];
+    float sumSquares = 0.0f;
+    unsigned shift = 2;
+    for (unsigned i = 0; i < 4; ++i)
+    {
+        if (i == largest)
+            continue;
+
+        unsigned bits = (quantized.rotation_ >> shift) & 0x3ff;
+        components[i] = (bits / ROTATION_RANGE * 2.0f - 1.0f) * ROTATION_MAX;
+        sumSquares += components[i] * components[i];
+        shift += 10;
+    }
+    components[largest] = Sqrt(Max(1.0f - sumSquares, 0.0f));
+    state.rotation_ = Quaternion(components[0], components[1], components[2], components[3]).Normalized();
+
+    state.linearVelocity_ = DequantizeVelocity(quantized.linearVelocity_);
+    state.angularVelocity_ = DequantizeVelocity(quantized.angularVelocity_);
+
+    return state;
+}
+
+void TransformCodec::Encode(const QuantizedTransform& state, const QuantizedTransform& baseline, unsigned char baselineId,
+    bool keyFrame, unsigned short timeStamp, Serializer& dest) const
+{
+    unsigned char flags = keyFrame ? FLAG_KEYFRAME : 0;
+
+    if (!EqualTriple(state.position_, baseline.position_))
+        flags |= FLAG_POSITION;
+    if (state.rotation_ != baseline.rotation_)
+        flags |= FLAG_ROTATION;
+    if (!EqualTriple(state.linearVelocity_, baseline.linearVelocity_))
+        flags |= FLAG_LINEAR_VELOCITY;
+    if (!EqualTriple(state.angularVelocity_, baseline.angularVelocity_))
+        flags |= FLAG_ANGULAR_VELOCITY;
+
+    dest.WriteUByte(flags);
+    dest.WriteUByte(baselineId);
+    dest.WriteUShort(timeStamp);
+
+    if (flags & FLAG_POSITION)
+        WriteDeltas(dest, state.position_, baseline.position_);
+    if (flags & FLAG_ROTATION)
+        dest.WriteUInt(state.rotation_);
+    if (flags & FLAG_LINEAR_VELOCITY)
+        WriteDeltas(dest, state.linearVelocity_, baseline.linearVelocity_);
+    if (flags & FLAG_ANGULAR_VELOCITY)
+        WriteDeltas(dest, state.angularVelocity_, baseline.angularVelocity_);
+}
+
+bool TransformCodec::DecodeHeader(Deserializer& source, unsigned char& flags, unsigned char& baselineId,
+    unsigned short& timeStamp) const
+{
+    if (source.GetSize() - source.GetPosition() < 4)
+        return false;
+
+    flags = source.ReadUByte();
+    baselineId = source.ReadUByte();
+    timeStamp = source.ReadUShort();
+
+    return true;
+}
+
+bool TransformCodec::IsKeyFrame(unsigned char flags)
+{
+    return (flags & FLAG_KEYFRAME) != 0;
+}
+
+unsigned short TransformCodec::ToTimeStamp(float time)
+{
+    return (unsigned short)((unsigned)(time * TIMESTAMP_SCALE) & 0xffff);
+}
+
+QuantizedTransform TransformCodec::DecodeBody(Deserializer& source, unsigned char flags, const QuantizedTransform& baseline) const
+{
+    QuantizedTransform state = baseline;
+
+    if (flags & FLAG_POSITION)
+        ReadDeltas(source, state.position_, baseline.position_);
+    if (flags & FLAG_ROTATION)
+        state.rotation_ = source.ReadUInt();
+    if (flags & FLAG_LINEAR_VELOCITY)
+        ReadDeltas(source, state.linearVelocity_, baseline.linearVelocity_);
+    if (flags & FLAG_ANGULAR_VELOCITY)
+        ReadDeltas(source, state.angularVelocity_, baseline.angularVelocity_);
+
+    return state;
+}
+
+void TransformCodec::RegisterCompactTransforms(Context* context)
+{
+    context->RemoveAttribute<Node>("Network Position");
+    context->RemoveAttribute<Node>("Network Rotation");
+    context->RemoveAttribute<RigidBody>("Linear Velocity");
+    context->RemoveAttribute<RigidBody>("Angular Velocity");
+}
+
+//=============================================================================
+//=============================================================================
+TransformStreamWriter::TransformStreamWriter()
+    : baselineId_(0)
+    , sinceKeyFrame_(0)
+    , started_(false)
+    , keyed_(false)
+{
+}
+
+bool TransformStreamWriter::Write(const TransformCodec& codec, const QuantizedTransform& state, float serverTime,
+    VectorBuffer& dest, bool keyFrame)
+{
+    bool changed = !started_ || state != lastSent_;
+    ++sinceKeyFrame_;
+
+    // at rest, nothing to send once the attribute holds a key frame that is not due for a refresh. The attribute value
+    // is what a late joiner gets in its first snapshot, so it must decode on its own
+    if (!changed && !keyFrame && keyed_ && sinceKeyFrame_ < KEYFRAME_INTERVAL)
+        return false;
+
+    dest.Clear();
+    unsigned short timeStamp = TransformCodec::ToTimeStamp(serverTime);
+
+    if (keyFrame || !changed || !started_ || sinceKeyFrame_ >= KEYFRAME_INTERVAL)
+    {
+        baseline_ = state;
+        ++baselineId_;
+        codec.Encode(state, QuantizedTransform(), baselineId_, true, timeStamp, dest);
+        sinceKeyFrame_ = 0;
+        keyed_ = true;
+    }
+    else
+    {
+        codec.Encode(state, baseline_, baselineId_, false, timeStamp, dest);
+        keyed_ = false;
+    }
+
+    lastSent_ = state;
+    started_ = true;
+
+    return true;
+}
+
+//=============================================================================
+//=============================================================================
+TransformStreamReader::TransformStreamReader()
+    : newestStamp_(0)
+    , newestTime_(0.0f)
+    , serverTime_(0.0f)
+    , timeStarted_(false)
+{
+    for (unsigned i = 0; i < NUM_BASELINES; ++i)
+    {
+        baselineIds_[i] = -1;
+    }
+}
+
+bool TransformStreamReader::Read(const TransformCodec& codec, Deserializer& source, QuantizedTransform& result)
+{
+    unsigned char flags, baselineId;
+    unsigned short timeStamp;
+    if (!codec.DecodeHeader(source, flags, baselineId, timeStamp))
+        return false;
+
+    // the stamp wraps every 65 seconds, take it relative to the newest one. A little older is a write that arrived out
+    // of order, anything else is newer, also after a gap longer than the wrap while the object was dormant
+    if (!timeStarted_)
+    {
+        newestStamp_ = timeStamp;
+        newestTime_ = timeStamp / TIMESTAMP_SCALE;
+        timeStarted_ = true;
+    }
+
+    unsigned short stampDelta = (unsigned short)(timeStamp - newestStamp_);
+    if (stampDelta > 0xffff - REORDER_WINDOW_MS)
+    {
+        serverTime_ = newestTime_ - (0x10000 - stampDelta) / TIMESTAMP_SCALE;
+    }
+    else
+    {
+        newestStamp_ = timeStamp;
+        newestTime_ += stampDelta / TIMESTAMP_SCALE;
+        serverTime_ = newestTime_;
+    }
+
+    unsigned index = baselineId % NUM_BASELINES;
+
+    if (TransformCodec::IsKeyFrame(flags))
+    {
+        result = codec.DecodeBody(source, flags, QuantizedTransform());
+        baselines_[index] = result;
+        baselineIds_[index] = baselineId;
+        return true;
+    }
+
+    if (baselineIds_[index] != (int)baselineId)
+        return false;
+
+    result = codec.DecodeBody(source, flags, baselines_[index]);
+    return true;
+}
@@ -0,0 +1,180 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include <Urho3D/Math/BoundingBox.h>
+#include <Urho3D/Math/Quaternion.h>
+
+namespace Urho3D
+{
+class Context;
+class Deserializer;
+class Serializer;
+class VectorBuffer;
+}
+
+using namespace Urho3D;
+//=============================================================================
+//=============================================================================
+/// Full precision physics state of a client object.
+struct TransformState
+{
+    TransformState()
+        : position_(Vector3::ZERO)
+        , rotation_(Quaternion::IDENTITY)
+        , linearVelocity_(Vector3::ZERO)
+        , angularVelocity_(Vector3::ZERO)
+    {
+    }
+
+    Vector3 position_;
+    Quaternion rotation_;
+    Vector3 linearVelocity_;
+    Vector3 angularVelocity_;
+};
+
+/// Quantized state, what is actually sent and what deltas are taken against.
+struct QuantizedTransform
+{
+    QuantizedTransform()
+        : rotation_(0)
+    {
+        for (unsigned i = 0; i < 3; ++i)
+        {
+            position_[i] = 0;
+            linearVelocity_[i] = 0;
+            angularVelocity_[i] = 0;
+        }
+    }
+
+    bool operator ==(const QuantizedTransform& rhs) const;
+    bool operator !=(const QuantizedTransform& rhs) const { return !(*this == rhs); }
+
+    /// 16 bits per axis against the level bounds.
+    int position_[3];
+    /// Smallest-three: 2 bit index of the dropped component, 3 x 10 bits.
+    unsigned rotation_;
+    /// Fixed point, VELOCITY_STEP units.
+    int linearVelocity_[3];
+    int angularVelocity_[3];
+};
+
+//=============================================================================
+//=============================================================================
+/// Compact transform stream for client objects. Position is quantized against the level bounds, rotation is sent as a
+/// smallest-three quaternion, and every field is sent as a delta against a baseline snapshot, omitted when unchanged.
+/// The header carries the server time the state was taken at, in wrapping milliseconds, so clients can place states on
+/// the server's timeline rather than their arrival time. A node coming to rest is sent once as a key frame, then nothing
+/// until the key frame is refreshed.
+///
+/// Error bounds with the default level bounds: position 4mm on X/Z and 1mm on Y, rotation under 0.15 degrees,
+/// velocities 0.005 m/s (rad/s).
+class TransformCodec
+{
+public:
+    TransformCodec();
+
+    /// Set the bounds positions are quantized against, must match on server and clients.
+    void SetBounds(const BoundingBox& bounds) { bounds_ = bounds; }
+    const BoundingBox& GetBounds() const { return bounds_; }
+
+    QuantizedTransform Quantize(const TransformState& state) const;
+    TransformState Dequantize(const QuantizedTransform& quantized) const;
+
+    /// Write state as a delta against baseline, tagged with the baseline's id and the server time stamp. Pass a zero
+    /// QuantizedTransform as the baseline to write a key frame.
+    void Encode(const QuantizedTransform& state, const QuantizedTransform& baseline, unsigned char baselineId, bool keyFrame,
+        unsigned short timeStamp, Serializer& dest) const;
+    /// Read the header, returns false on a malformed stream.
+    bool DecodeHeader(Deserializer& source, unsigned char& flags, unsigned char& baselineId, unsigned short& timeStamp) const;
+    /// Read the rest of the stream against the baseline named in the header.
+    QuantizedTransform DecodeBody(Deserializer& source, unsigned char flags, const QuantizedTransform& baseline) const;
+    /// Return whether header flags mark a key frame, which is a delta against a zero baseline.
+    static bool IsKeyFrame(unsigned char flags);
+    /// Convert server time in seconds to the wrapping millisecond stamp in the header.
+    static unsigned short ToTimeStamp(float time);
+
+    /// Remove the engine's own node transform and rigid body velocity network attributes, so client objects move only
+    /// through the compact stream. Must be done on the server and on every client before any scene is replicated.
+    static void RegisterCompactTransforms(Context* context);
+
+    static const float VELOCITY_STEP;
+
+private:
+    BoundingBox bounds_;
+};
+
+//=============================================================================
+//=============================================================================
+/// Sending side of one object's stream. A key frame is written every KEYFRAME_INTERVAL writes to become the baseline for
+/// the following deltas. An unchanged state is written as a key frame once, then again only every KEYFRAME_INTERVAL
+/// writes, so the last value always decodes for a new observer and a lost key frame is recovered.
+class TransformStreamWriter
+{
+public:
+    TransformStreamWriter();
+
+    /// Encode state, taken at serverTime, into dest if it changed or a key frame is due, returns whether anything was
+    /// written. Call once per network update, or force a key frame for a state that will not be written again for a while.
+    bool Write(const TransformCodec& codec, const QuantizedTransform& state, float serverTime, VectorBuffer& dest,
+        bool keyFrame = false);
+
+    /// Return the last state written.
+    const QuantizedTransform& GetLastSent() const { return lastSent_; }
+
+    static const unsigned KEYFRAME_INTERVAL = 20;
+
+private:
+    QuantizedTransform baseline_;
+    QuantizedTransform lastSent_;
+    unsigned char baselineId_;
+    unsigned sinceKeyFrame_;
+    bool started_;
+    /// Last write was a key frame.
+    bool keyed_;
+};
+
+/// Receiving side of one object's stream, keeps the last few key frames by id. Deltas against a key frame that was
+/// never received are dropped until the next key frame arrives. Time stamps are unwrapped into server time in seconds,
+/// counted from the first one received.
+class TransformStreamReader
+{
+public:
+    TransformStreamReader();
+
+    /// Decode one write, returns false if it can't be decoded yet.
+    bool Read(const TransformCodec& codec, Deserializer& source, QuantizedTransform& result);
+    /// Return the server time of the last decoded state.
+    float GetServerTime() const { return serverTime_; }
+
+    static const unsigned NUM_BASELINES = 4;
+
+private:
+    QuantizedTransform baselines_[NUM_BASELINES];
+    int baselineIds_[NUM_BASELINES];
+    /// Newest time stamp seen and its unwrapped time.
+    unsigned short newestStamp_;
+    float newestTime_;
+    float serverTime_;
+    bool timeStarted_;
+};